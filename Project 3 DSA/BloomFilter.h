@@ -0,0 +1,98 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include "HashPolicies.h"
+
+using namespace std;
+
+// Blocked Bloom filter over Order IDs. Every key maps to a single 64-byte
+// block (one cache line) and sets NUM_PROBES bits inside it, so a query
+// touches exactly one cache line. A "no" is definite, a "yes" may be a
+// false positive.
+class BloomFilter {
+private:
+    // one cache line of bits
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+
+    static const int NUM_PROBES = 8;
+
+    // bits per expected key, ~1% false positives for a blocked filter
+    static const int BITS_PER_KEY = 10;
+
+    vector<Block> blocks;
+    size_t numKeys = 0;
+
+    // independent of the hash map's hash so bucket clustering does not carry over
+    WyHash hasher;
+
+    Block& blockFor(uint64_t hash) {
+        return blocks[((hash >> 32) * blocks.size()) >> 32];
+    }
+
+    const Block& blockFor(uint64_t hash) const {
+        return blocks[((hash >> 32) * blocks.size()) >> 32];
+    }
+
+public:
+    BloomFilter() { reset(0); }
+
+    // Clear the filter and size it for the expected number of keys
+    void reset(size_t expectedKeys) {
+        size_t numBlocks = (max<size_t>(expectedKeys, 1) * BITS_PER_KEY + 511) / 512;
+        blocks.assign(numBlocks, Block{});
+        numKeys = 0;
+    }
+
+    void insert(const string& orderID) {
+        uint64_t hash = hasher(orderID);
+        Block& block = blockFor(hash);
+        // double hashing inside the block from the low 32 bits
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = (h1 >> 16) | (h1 << 16) | 1;
+        for (int i = 0; i < NUM_PROBES; ++i) {
+            uint32_t bit = (h1 + i * h2) & 511;
+            block.words[bit >> 6] |= 1ULL << (bit & 63);
+        }
+        numKeys++;
+    }
+
+    bool mightContain(const string& orderID) const {
+        uint64_t hash = hasher(orderID);
+        const Block& block = blockFor(hash);
+        uint32_t h1 = static_cast<uint32_t>(hash);
+        uint32_t h2 = (h1 >> 16) | (h1 << 16) | 1;
+        for (int i = 0; i < NUM_PROBES; ++i) {
+            uint32_t bit = (h1 + i * h2) & 511;
+            if ((block.words[bit >> 6] & (1ULL << (bit & 63))) == 0) return false;
+        }
+        return true;
+    }
+
+    // number of keys the filter was sized for before its rate degrades
+    size_t capacity() const {
+        return blocks.size() * 512 / BITS_PER_KEY;
+    }
+
+    size_t size() const {
+        return numKeys;
+    }
+
+    size_t memoryBytes() const {
+        return blocks.size() * sizeof(Block);
+    }
+
+    // false positive rate of a classic filter with the same bits and keys;
+    // blocking makes the real rate a little higher
+    double expectedFalsePositiveRate() const {
+        double bits = static_cast<double>(blocks.size()) * 512;
+        return pow(1 - exp(-static_cast<double>(NUM_PROBES) * numKeys / bits), NUM_PROBES);
+    }
+};
+
+#endif // BLOOM_FILTER_H
@@ -0,0 +1,91 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <shared_mutex>
+#include <mutex>
+#include <memory>
+#include "SalesData.h"
+#include "HashPolicies.h"
+
+using namespace std;
+
+// Thread-safe variant of CustomHashMap for concurrent lookups and inserts.
+// The buckets are split into stripes, every stripe guarded by its own
+// reader/writer lock: lookups share the lock of the one stripe they touch
+// and inserts take it exclusively, so threads only wait for each other when
+// they hit the same stripe. Records are copied out (or visited under the
+// lock) because a concurrent insert may move the bucket they live in.
+template <typename HashPolicy = PolynomialHash>
+class ConcurrentHashMap {
+private:
+    // one lock per cache line so neighbouring stripes do not false share
+    struct alignas(64) Stripe {
+        shared_mutex lock;
+    };
+
+    size_t bucketMask;
+    size_t stripeMask;
+    vector<vector<SalesData>> buckets;
+    unique_ptr<Stripe[]> stripes;
+    atomic<size_t> numRecords{0};
+    HashPolicy hasher;
+
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+public:
+    // numBuckets and numStripes are rounded up to powers of two; a single
+    // stripe makes this a map behind one global lock
+    explicit ConcurrentHashMap(size_t numBuckets = 1 << 16, size_t numStripes = 64)
+        : bucketMask(roundUpToPowerOfTwo(numBuckets) - 1),
+          stripeMask(roundUpToPowerOfTwo(min(numStripes, numBuckets)) - 1),
+          buckets(bucketMask + 1),
+          stripes(new Stripe[stripeMask + 1]) {}
+
+    void insert(const SalesData& record) {
+        size_t bucket = hasher(record.orderID) & bucketMask;
+        unique_lock<shared_mutex> lock(stripes[bucket & stripeMask].lock);
+        buckets[bucket].push_back(record);
+        numRecords.fetch_add(1, memory_order_relaxed);
+    }
+
+    // Call visit(record) on the record with this Order ID while its stripe
+    // is locked for reading; false if there is none
+    template <typename Visitor>
+    bool visit(const string& orderID, Visitor visit) {
+        size_t bucket = hasher(orderID) & bucketMask;
+        shared_lock<shared_mutex> lock(stripes[bucket & stripeMask].lock);
+        for (const SalesData& record : buckets[bucket]) {
+            if (record.orderID == orderID) {
+                visit(record);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Copy of the record with this Order ID
+    bool find(const string& orderID, SalesData& result) {
+        return visit(orderID, [&result](const SalesData& record) { result = record; });
+    }
+
+    bool contains(const string& orderID) {
+        return visit(orderID, [](const SalesData&) {});
+    }
+
+    size_t size() const {
+        return numRecords.load(memory_order_relaxed);
+    }
+
+    size_t numStripes() const {
+        return stripeMask + 1;
+    }
+};
+
+#endif // CONCURRENT_HASH_MAP_H
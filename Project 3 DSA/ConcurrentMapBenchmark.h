@@ -0,0 +1,115 @@
+#ifndef CONCURRENT_MAP_BENCHMARK_H
+#define CONCURRENT_MAP_BENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "ConcurrentHashMap.h"
+
+using namespace std;
+
+struct ConcurrentRunResult {
+    double lookupsPerSecond;
+    size_t inserts; // done by the writer while the readers ran
+};
+
+// threads readers split LOOKUPS lookups of loaded Order IDs between them;
+// with a writer, one more thread keeps inserting new records until they finish
+inline ConcurrentRunResult runConcurrentLookups(ConcurrentHashMap<>& map, const vector<string>& ids,
+                                                const vector<SalesData>& newRecords, size_t threads,
+                                                bool withWriter) {
+    const size_t LOOKUPS = 2000000;
+    atomic<bool> go{false};
+    atomic<size_t> readersDone{0};
+    atomic<size_t> found{0};
+    size_t inserts = 0;
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            while (!go.load(memory_order_acquire)) this_thread::yield();
+            // xorshift over the key set, a different sequence per thread
+            uint64_t x = 0x9e3779b97f4a7c15ULL * (t + 1);
+            size_t hits = 0;
+            for (size_t i = 0; i < LOOKUPS / threads; ++i) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                hits += map.contains(ids[x % ids.size()]);
+            }
+            found += hits;
+            readersDone++;
+        });
+    }
+    thread writer;
+    if (withWriter) {
+        writer = thread([&] {
+            while (!go.load(memory_order_acquire)) this_thread::yield();
+            while (readersDone.load() < threads && inserts < newRecords.size()) {
+                map.insert(newRecords[inserts++]);
+            }
+        });
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+    go.store(true, memory_order_release);
+    for (auto& worker : workers) worker.join();
+    auto end = chrono::high_resolution_clock::now();
+    if (withWriter) writer.join();
+
+    double seconds = chrono::duration<double>(end - start).count();
+    return {(LOOKUPS / threads) * threads / seconds, inserts};
+}
+
+// Lookup throughput of the striped map against the same map behind one
+// global lock, for 1 to maxThreads reader threads, with and without a
+// concurrent writer
+inline void runConcurrentMapBenchmark(const vector<const SalesData*>& records, size_t maxThreads) {
+    vector<string> ids;
+    ids.reserve(records.size());
+    for (const SalesData* record : records) ids.push_back(record->orderID);
+
+    // the writer inserts copies under new Order IDs
+    vector<SalesData> newRecords;
+    newRecords.reserve(records.size());
+    for (const SalesData* record : records) {
+        newRecords.push_back(*record);
+        newRecords.back().orderID = "N" + record->orderID;
+    }
+
+    cout << "\n--- Concurrent Hash Map Benchmark ---\n";
+    cout << "Records: " << records.size() << ", hardware threads: " << thread::hardware_concurrency() << "\n";
+    cout << "Lookups per second (millions), speedup over 1 thread in brackets\n";
+    cout << left << setw(9) << "Threads" << setw(18) << "global lock" << setw(18) << "64 stripes"
+         << setw(18) << "global + writer" << setw(18) << "64 str. + writer" << "inserts (global/striped)\n";
+
+    double base[4] = {0, 0, 0, 0};
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        ConcurrentRunResult results[4];
+        for (int variant = 0; variant < 4; ++variant) {
+            bool striped = variant % 2 == 1;
+            bool withWriter = variant >= 2;
+            ConcurrentHashMap<> map(1 << 16, striped ? 64 : 1);
+            for (const SalesData* record : records) map.insert(*record);
+            results[variant] = runConcurrentLookups(map, ids, newRecords, threads, withWriter);
+            if (threads == 1) base[variant] = results[variant].lookupsPerSecond;
+        }
+
+        cout << left << setw(9) << threads;
+        for (int variant = 0; variant < 4; ++variant) {
+            ostringstream cell;
+            cell << fixed << setprecision(2) << results[variant].lookupsPerSecond / 1e6 << " ("
+                 << results[variant].lookupsPerSecond / base[variant] << "x)";
+            cout << setw(18) << cell.str();
+        }
+        cout << results[2].inserts << "/" << results[3].inserts << "\n";
+    }
+    cout << right;
+}
+
+#endif // CONCURRENT_MAP_BENCHMARK_H
@@ -0,0 +1,170 @@
+#ifndef CUBE_H
+#define CUBE_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "SalesTable.h"
+#include "ResultWriter.h"
+
+using namespace std;
+
+// Profit/revenue/count aggregates for every grouping set of a list of
+// dimensions (the SQL CUBE). Each dimension gets one coordinate per
+// dictionary code plus a trailing "all" coordinate, and the cells live in
+// one dense row-major array. One pass over the table fills the detail
+// cells, then each dimension is rolled up into its "all" coordinate in
+// turn, which yields every subtotal without touching the rows again.
+class Cube {
+private:
+    vector<Dimension> dims;
+    vector<size_t> extents; // dictionary size + 1 per dimension
+    vector<size_t> strides;
+    vector<double> profit;
+    vector<double> revenue;
+    vector<size_t> count;
+
+public:
+    // most cells we are willing to allocate
+    static const size_t MAX_CELLS = 1 << 24;
+
+    // false if the cube would be too large
+    bool build(const SalesTable& table, const vector<Dimension>& dimensions) {
+        dims = dimensions;
+        extents.clear();
+        strides.assign(dims.size(), 1);
+        size_t cells = 1;
+        for (Dimension dim : dims) {
+            extents.push_back(table.dictionary(dim).size() + 1);
+            cells *= extents.back();
+            if (cells > MAX_CELLS) return false;
+        }
+        for (int d = static_cast<int>(dims.size()) - 2; d >= 0; --d) {
+            strides[d] = strides[d + 1] * extents[d + 1];
+        }
+        profit.assign(cells, 0);
+        revenue.assign(cells, 0);
+        count.assign(cells, 0);
+
+        // single pass over the rows into the detail cells
+        vector<const uint16_t*> columns;
+        for (Dimension dim : dims) columns.push_back(table.codes(dim).data());
+        for (size_t row = 0; row < table.size(); ++row) {
+            size_t cell = 0;
+            for (size_t d = 0; d < dims.size(); ++d) {
+                cell += columns[d][row] * strides[d];
+            }
+            profit[cell] += table.totalProfit[row];
+            revenue[cell] += table.totalRevenue[row];
+            count[cell]++;
+        }
+
+        // roll every dimension up into its "all" coordinate
+        for (size_t d = 0; d < dims.size(); ++d) {
+            size_t all = extents[d] - 1;
+            for (size_t cell = 0; cell < cells; ++cell) {
+                size_t coordinate = cell / strides[d] % extents[d];
+                if (coordinate == all) continue;
+                size_t target = cell + (all - coordinate) * strides[d];
+                profit[target] += profit[cell];
+                revenue[target] += revenue[cell];
+                count[target] += count[cell];
+            }
+        }
+        return true;
+    }
+
+    size_t numCells() const {
+        return count.size();
+    }
+
+    // Call visit(labels, cell) for every non-empty cell, values
+    // alphabetically and each subtotal ("(all)") after the rows it covers
+    template <typename Visit>
+    void forEachCell(const SalesTable& table, Visit visit) const {
+        // alphabetical order of the codes per dimension, "all" last
+        vector<vector<size_t>> order(dims.size());
+        for (size_t d = 0; d < dims.size(); ++d) {
+            const Dictionary& dictionary = table.dictionary(dims[d]);
+            for (size_t c = 0; c < dictionary.size(); ++c) {
+                order[d].push_back(c);
+            }
+            sort(order[d].begin(), order[d].end(),
+                 [&](size_t a, size_t b) { return dictionary.decode(a) < dictionary.decode(b); });
+            order[d].push_back(extents[d] - 1);
+        }
+
+        // mixed radix counter over the sorted positions
+        vector<size_t> position(dims.size(), 0);
+        vector<string> labels(dims.size());
+        while (true) {
+            size_t cell = 0;
+            for (size_t d = 0; d < dims.size(); ++d) {
+                cell += order[d][position[d]] * strides[d];
+            }
+            if (count[cell] > 0) {
+                for (size_t d = 0; d < dims.size(); ++d) {
+                    size_t code = order[d][position[d]];
+                    labels[d] = code == extents[d] - 1 ? string("(all)") : table.dictionary(dims[d]).decode(code);
+                }
+                visit(labels, cell);
+            }
+            int d = static_cast<int>(dims.size()) - 1;
+            while (d >= 0 && ++position[d] == extents[d]) {
+                position[d] = 0;
+                d--;
+            }
+            if (d < 0) break;
+        }
+    }
+
+    // Print every non-empty cell as a table
+    void print(const SalesTable& table, ostream& os = cout) const {
+        vector<size_t> widths;
+        for (size_t d = 0; d < dims.size(); ++d) {
+            const Dictionary& dictionary = table.dictionary(dims[d]);
+            size_t width = max<size_t>(string(dimensionName(dims[d])).size(), 5);
+            for (size_t c = 0; c < dictionary.size(); ++c) {
+                width = max(width, dictionary.decode(c).size());
+            }
+            widths.push_back(width + 2);
+        }
+
+        os << "\n--- Cube ---\n";
+        for (size_t d = 0; d < dims.size(); ++d) {
+            os << left << setw(widths[d]) << dimensionName(dims[d]);
+        }
+        os << right << setw(10) << "Orders" << setw(20) << "Total Revenue" << setw(20) << "Total Profit" << "\n";
+
+        os << fixed << setprecision(2);
+        forEachCell(table, [&](const vector<string>& labels, size_t cell) {
+            for (size_t d = 0; d < dims.size(); ++d) {
+                os << left << setw(widths[d]) << labels[d];
+            }
+            os << right << setw(10) << count[cell] << setw(20) << revenue[cell]
+                 << setw(20) << profit[cell] << "\n";
+        });
+    }
+
+    // Start a CSV or JSON result with one row per non-empty cell; the
+    // caller adds any summaries and ends it
+    void write(const SalesTable& table, ResultWriter& out) const {
+        vector<ResultWriter::Column> columns;
+        for (Dimension dim : dims) columns.push_back({dimensionKey(dim), ""});
+        columns.push_back({"orders", ""});
+        columns.push_back({"total_revenue", ""});
+        columns.push_back({"total_profit", ""});
+        out.begin("Cube", columns);
+        forEachCell(table, [&](const vector<string>& labels, size_t cell) {
+            for (const string& label : labels) out.text(label);
+            out.integer(count[cell]);
+            out.money(revenue[cell]);
+            out.money(profit[cell]);
+            out.endRow();
+        });
+    }
+};
+
+#endif // CUBE_H
@@ -8,21 +8,31 @@
 #include <iomanip>
 #include <fstream>
 #include <limits>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
 #include "SalesData.h"
+#include "HashPolicies.h"
+#include "GroupAggregates.h"
+#include "ResultWriter.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
+// HashPolicy turns an Order ID into a hash, see HashPolicies.h
+template <typename HashPolicy = PolynomialHash>
 class CustomHashMap {
 private:
     // number of records stored in the map
-    int num_records;
+    int num_records = 0;
 
-    // Prime number for hash calculation to reduce collisions
-    static const int HASH_PRIME = 31;
-
-    // Number of buckets in our hash map
+    // Number of buckets in our hash map, kept a power of two so the
+    // bucket index is just the low bits of the hash
     static const int NUM_BUCKETS = 1024;
 
+    // Hash policy used for Order IDs
+    HashPolicy hasher;
+
     // Headers for display purposes
     vector<string> headers = {
             "Region", "Country", "Item Type", "Sales Channel",
@@ -34,13 +44,12 @@ private:
     // Buckets are vectors to handle collisions via chaining
     vector<vector<SalesData>> buckets;
 
+    // Profit totals per region, country and item type, kept current by insert()
+    GroupAggregates aggregates;
+
     // Custom hash function for Order ID
-    size_t hashFunction(const string& orderID) {
-        size_t hash = 0;
-        for (char c : orderID) {
-            hash = (hash * HASH_PRIME + c) % NUM_BUCKETS;
-        }
-        return hash;
+    size_t hashFunction(const string& orderID) const {
+        return hasher(orderID) & (NUM_BUCKETS - 1);
     }
 
     // Trim whitespace
@@ -60,6 +69,11 @@ public:
     // Constructor to initialize buckets
     CustomHashMap() : buckets(NUM_BUCKETS) {}
 
+    // read-only access to the buckets for benchmarks and diagnostics
+    const vector<vector<SalesData>>& getBuckets() const {
+        return buckets;
+    }
+
     // Insert a record into the hash map
     void insert(SalesData& record) {
         try { // number of records increases
@@ -68,6 +82,9 @@ public:
             // Calculate hash and insert
             size_t bucketIndex = hashFunction(record.orderID);
             buckets[bucketIndex].push_back(record);
+
+            // keep the per-group totals current
+            aggregates.add(record);
         } catch (const exception& e) {
             cerr << "Error inserting record: " << e.what() << endl;
         }
@@ -87,6 +104,42 @@ public:
         return nullptr; // Not found
     }
 
+    // Find a batch of Order IDs. Keys are handled in groups: hash the whole
+    // group and prefetch every target bucket, then prefetch the first record
+    // of each chain, then resolve them. The cache misses of independent keys
+    // overlap instead of being paid one after another like in find().
+    // results[i] is the record for orderIDs[i] or nullptr.
+    void findMany(const vector<string>& orderIDs, vector<SalesData*>& results) {
+        static const size_t GROUP_SIZE = 16;
+        results.assign(orderIDs.size(), nullptr);
+        size_t bucketIndex[GROUP_SIZE];
+
+        for (size_t base = 0; base < orderIDs.size(); base += GROUP_SIZE) {
+            size_t count = min(GROUP_SIZE, orderIDs.size() - base);
+
+            // hash every key of the group and prefetch its bucket header
+            for (size_t i = 0; i < count; ++i) {
+                bucketIndex[i] = hashFunction(orderIDs[base + i]);
+                __builtin_prefetch(&buckets[bucketIndex[i]]);
+            }
+            // prefetch the head of each chain
+            for (size_t i = 0; i < count; ++i) {
+                const auto& bucket = buckets[bucketIndex[i]];
+                if (!bucket.empty()) __builtin_prefetch(bucket.data());
+            }
+            // resolve
+            for (size_t i = 0; i < count; ++i) {
+                const string& orderID = orderIDs[base + i];
+                for (auto& record : buckets[bucketIndex[i]]) {
+                    if (record.orderID == orderID) {
+                        results[base + i] = &record;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
     // Find and display record with highest profit
     // returns a pair of the orderID and sales data object translated from the record
     pair<string,SalesData> displayHighestProfitRecord() {
@@ -110,83 +163,173 @@ public:
         return make_pair(highestProfitRecord.orderID,highestProfitRecord);
     }
 
-    void aggregateByRegion(){
-        vector<pair<string,double>> regionalMap;
-        for (const auto& bucket : buckets) {
-            for (const auto& record : bucket) {
-                bool val = true;
-                for(auto & i : regionalMap){
-                    if(i.first == record.region) {
-                        i.second+= record.totalProfit;
-                        val = false;
-                        break;
+    // Highest profit record like displayHighestProfitRecord(), with the
+    // buckets scanned in parallel on pool; nullptr if the map is empty
+    const SalesData* findHighestProfitRecord(ThreadPool& pool) const {
+        typedef const SalesData* Best;
+        return parallelReduce<Best>(pool, 0, buckets.size(), defaultGrain(buckets.size(), pool), nullptr,
+            [this](size_t first, size_t last) {
+                Best best = nullptr;
+                for (size_t b = first; b < last; ++b) {
+                    for (const auto& record : buckets[b]) {
+                        if (best == nullptr || record.totalProfit > best->totalProfit) best = &record;
                     }
                 }
-                if(val) regionalMap.push_back(make_pair(record.region,0));
-            }
-        }
-        cout << "\n--- Total Profits by Region ---\n";
-        for(const auto& regionProfit: regionalMap){
-            cout << fixed << setprecision(2);
-            cout << regionProfit.first << ": $" << regionProfit.second << "\n";
-        }
+                return best;
+            },
+            [](Best left, Best right) {
+                // the earlier record wins ties, as in a sequential scan
+                return right != nullptr && (left == nullptr || right->totalProfit > left->totalProfit) ? right : left;
+            });
     }
 
-    void aggregateByCountry(){
-        vector<pair<string,double>> countryMap;
+    // Totals maintained by insert()
+    const GroupAggregates& getAggregates() const {
+        return aggregates;
+    }
+
+    // Recompute the profit total per group with a full scan of the buckets,
+    // e.g. scanTotals(&SalesData::region); used to check the maintained totals
+    vector<pair<string,double>> scanTotals(string SalesData::* field) const {
+        vector<pair<string,double>> totals;
+        unordered_map<string, size_t> slots;
         for (const auto& bucket : buckets) {
             for (const auto& record : bucket) {
-                bool val = true;
-                for(auto & i : countryMap){
-                    if(i.first == record.country) {
-                        i.second+= record.totalProfit;
-                        val = false;
-                        break;
-                    }
+                auto it = slots.find(record.*field);
+                if (it == slots.end()) {
+                    slots.emplace(record.*field, totals.size());
+                    totals.emplace_back(record.*field, record.totalProfit);
+                } else {
+                    totals[it->second].second += record.totalProfit;
                 }
-                if(val) countryMap.push_back(make_pair(record.country,0));
             }
         }
-        cout << "\n--- Total Profits by Country ---\n";
-        // Sort countries by profit
-        vector<pair<string, double>> sortedProfits(countryMap.begin(), countryMap.end());
-        sort(sortedProfits.begin(), sortedProfits.end(),
-             [](const auto& a, const auto& b) { return a.second > b.second; });
-        for (const auto& countryProfit : sortedProfits) {
-            cout << fixed << setprecision(2);
-            cout << countryProfit.first << ": $" << countryProfit.second << "\n";
-        }
+        return totals;
     }
 
-    void topPerformingItems(int& n){
-        vector<pair<string,double>> ItemMap;
-        for (const auto& bucket : buckets) {
-            for (const auto& record : bucket) {
-                bool val = true;
-                for(auto & i : ItemMap){
-                    if(i.first == record.itemType) {
-                        i.second+= record.totalProfit;
-                        val = false;
-                        break;
+    // scanTotals() with the buckets split over pool; groups come out in the
+    // same first-seen order
+    vector<pair<string,double>> scanTotals(string SalesData::* field, ThreadPool& pool) const {
+        GroupTotals totals = parallelReduce<GroupTotals>(
+            pool, 0, buckets.size(), defaultGrain(buckets.size(), pool), GroupTotals(),
+            [this, field](size_t first, size_t last) {
+                GroupTotals chunk;
+                for (size_t b = first; b < last; ++b) {
+                    for (const auto& record : buckets[b]) {
+                        chunk.add(record.*field, record.totalProfit);
                     }
                 }
-                if(val) ItemMap.push_back(make_pair(record.itemType,0));
-            }
+                return chunk;
+            },
+            [](GroupTotals left, GroupTotals right) {
+                for (const auto& group : right.get()) {
+                    left.add(group.first, group.second);
+                }
+                return left;
+            });
+        return totals.get();
+    }
+
+    void aggregateByRegion(ResultWriter& out){
+        writeRegionTotals(aggregates, out);
+    }
+
+    void aggregateByCountry(ResultWriter& out){
+        writeCountryTotals(aggregates, out);
+    }
+
+    void topPerformingItems(int& n, ResultWriter& out){
+        writeTopItems(aggregates, n, out);
+    }
+
+    // Print bucket occupancy and probe statistics, compared against what an
+    // ideal uniform hash (chain lengths ~ Poisson(load factor)) would give
+    void printHashStats() const {
+        // chain length of every bucket
+        vector<size_t> lengths;
+        lengths.reserve(buckets.size());
+        size_t total = 0, maxLength = 0, emptyBuckets = 0;
+        double sumSquares = 0;
+        for (const auto& bucket : buckets) {
+            size_t len = bucket.size();
+            lengths.push_back(len);
+            total += len;
+            sumSquares += static_cast<double>(len) * len;
+            if (len > maxLength) maxLength = len;
+            if (len == 0) emptyBuckets++;
+        }
+        if (total == 0) {
+            cout << "No records found." << endl;
+            return;
+        }
+
+        double m = static_cast<double>(buckets.size());
+        double n = static_cast<double>(total);
+        double loadFactor = n / m;
+
+        // variance of the chain length, Poisson would have variance == mean
+        double variance = sumSquares / m - loadFactor * loadFactor;
+
+        // successful lookup: the i-th record of a chain costs i comparisons
+        double successful = (sumSquares + n) / (2 * n);
+        double idealSuccessful = 1 + (n - 1) / (2 * m);
+
+        // unsuccessful lookup walks the whole chain; weight each bucket by how
+        // often absent IDs shaped like the loaded ones would hash into it.
+        // A uniform hash puts the other n - 1 keys in a key's bucket with
+        // probability 1/m each, hence 1 + (n - 1) / m.
+        double unsuccessful = sumSquares / n;
+        double idealUnsuccessful = 1 + (n - 1) / m;
+
+        cout << "\n--- Hash Map Statistics ---\n";
+        cout << fixed << setprecision(2);
+        cout << "Records:                    " << total << "\n";
+        cout << "Buckets:                    " << buckets.size() << "\n";
+        cout << "Load factor:                " << loadFactor << "\n";
+        cout << "Empty buckets:              " << emptyBuckets
+             << " (ideal " << m * exp(-loadFactor) << ")\n";
+        cout << "Max chain length:           " << maxLength << "\n";
+        cout << "Mean chain length:          " << loadFactor
+             << " (non-empty: " << n / (m - emptyBuckets) << ")\n";
+        cout << "Chain length std dev:       " << sqrt(max(variance, 0.0))
+             << " (ideal " << sqrt(loadFactor) << ")\n";
+        cout << "Comparisons (successful):   " << successful
+             << " (ideal " << idealSuccessful << ")\n";
+        cout << "Comparisons (unsuccessful): " << unsuccessful
+             << " (ideal " << idealUnsuccessful << ")\n";
+
+        // group chain lengths into at most 16 bins so large loads stay readable
+        size_t binWidth = maxLength / 16 + 1;
+        size_t numBins = maxLength / binWidth + 1;
+        vector<size_t> observed(numBins, 0);
+        for (size_t len : lengths) {
+            observed[len / binWidth]++;
         }
-        // Sort items by profit
-        vector<pair<string, double>> sortedItems(
-                ItemMap.begin(), ItemMap.end()
-        );
-
-        sort(sortedItems.begin(), sortedItems.end(),
-             [](const auto& a, const auto& b) { return a.second > b.second; });
-
-        cout << "\n--- Top " << n << " Performing Items ---\n";
-        for (int i = 0; i < min(n, static_cast<int>(sortedItems.size())); ++i) {
-            cout << fixed << setprecision(2);
-            cout << (i+1) << ". " << sortedItems[i].first
-                 << ": $" << sortedItems[i].second << "\n";
+
+        // expected buckets per bin under Poisson(loadFactor), pmf built iteratively
+        vector<double> expected(numBins, 0);
+        double pmf = exp(-loadFactor);
+        for (size_t k = 0; k <= maxLength; ++k) {
+            if (k > 0) pmf *= loadFactor / k;
+            expected[k / binWidth] += pmf * m;
         }
+
+        size_t peak = *max_element(observed.begin(), observed.end());
+        cout << "\n--- Bucket Occupancy Histogram ---\n";
+        cout << setw(11) << "Length" << setw(10) << "Buckets" << setw(10) << "Ideal" << "\n";
+        for (size_t b = 0; b < numBins; ++b) {
+            size_t lo = b * binWidth;
+            size_t hi = lo + binWidth - 1;
+            string label = binWidth == 1 ? to_string(lo) : to_string(lo) + "-" + to_string(hi);
+            cout << setw(11) << label << setw(10) << observed[b] << setw(10) << expected[b] << "  "
+                 << string(observed[b] * 40 / peak, '#') << "\n";
+        }
+
+        // chi-square over the individual buckets, sum((len - mean)^2 / mean);
+        // a uniform hash lands near m - 1, i.e. a dispersion index near 1
+        double chiSquare = m * variance / loadFactor;
+        cout << "Chi-square vs uniform:      " << chiSquare << " over " << buckets.size() - 1
+             << " degrees of freedom (dispersion " << chiSquare / (m - 1) << ", ideal 1.00)\n";
     }
 
 };
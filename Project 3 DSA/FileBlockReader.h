@@ -0,0 +1,354 @@
+#ifndef FILE_BLOCK_READER_H
+#define FILE_BLOCK_READER_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "LoadPipeline.h"
+
+using namespace std;
+
+// Reads a list of files as a stream of large blocks, in file order and in
+// order within each file. With io_uring up to queueDepth reads are in flight
+// at once, spread over the next blocks of the current and following files,
+// so the kernel is already fetching ahead while the caller works on the
+// block it just got. Without io_uring (an old kernel, or blocked by a
+// sandbox) every block is read with a plain pread when it is asked for.
+// Linux only.
+class FileBlockReader {
+public:
+    struct Block {
+        size_t file;      // index into the path list
+        bool firstOfFile; // the block starts at offset 0 of its file
+        string data;
+    };
+
+private:
+    // Submission and completion rings shared with the kernel, driven with
+    // the raw io_uring_setup / io_uring_enter system calls
+    struct Ring {
+        int fd = -1;
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_sqe* sqes = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        void* sqMap = MAP_FAILED;
+        void* cqMap = MAP_FAILED;
+        size_t sqMapSize = 0;
+        size_t cqMapSize = 0;
+        size_t sqesSize = 0;
+    };
+
+    // One block of one file
+    struct Chunk {
+        size_t file;
+        uint64_t offset;
+        size_t length;
+    };
+
+    // Buffer of an in-flight read; chunk c always uses slot c % queueDepth
+    struct Slot {
+        string buffer;
+        size_t done = 0;
+        bool ready = false;
+    };
+
+    vector<string> paths;
+    vector<int> fds;
+    vector<Chunk> chunks;
+    vector<Slot> slots;
+    size_t nextSubmit = 0;
+    size_t nextDeliver = 0;
+    size_t inFlight = 0;
+    size_t bytes = 0;
+    Ring ring;
+    bool uring = false;
+    string failure;
+
+    bool setupRing(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+        ring.fd = fd;
+
+        ring.sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            ring.sqMapSize = ring.cqMapSize = max(ring.sqMapSize, ring.cqMapSize);
+        }
+        ring.sqMap = mmap(nullptr, ring.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_SQ_RING);
+        if (ring.sqMap == MAP_FAILED) return false;
+        if (singleMap) {
+            ring.cqMap = ring.sqMap;
+        } else {
+            ring.cqMap = mmap(nullptr, ring.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              fd, IORING_OFF_CQ_RING);
+            if (ring.cqMap == MAP_FAILED) return false;
+        }
+        ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        ring.sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(ring.sqMap);
+        char* cq = static_cast<char*>(ring.cqMap);
+        ring.sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring.sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring.sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring.cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring.cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring.cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring.cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return supportsRead();
+    }
+
+    // IORING_OP_READ came with kernel 5.6, as did the probe itself
+    bool supportsRead() {
+        vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        return probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    void closeRing() {
+        if (ring.sqes != nullptr) munmap(ring.sqes, ring.sqesSize);
+        if (ring.cqMap != MAP_FAILED && ring.cqMap != ring.sqMap) munmap(ring.cqMap, ring.cqMapSize);
+        if (ring.sqMap != MAP_FAILED) munmap(ring.sqMap, ring.sqMapSize);
+        if (ring.fd >= 0) close(ring.fd);
+        ring = Ring();
+    }
+
+    // Queue a read of what is still missing from a chunk's slot
+    void queueRead(size_t chunk) {
+        const Chunk& c = chunks[chunk];
+        Slot& slot = slots[chunk % slots.size()];
+        unsigned tail = *ring.sqTail;
+        unsigned index = tail & *ring.sqMask;
+        io_uring_sqe& sqe = ring.sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fds[c.file];
+        sqe.addr = reinterpret_cast<uint64_t>(&slot.buffer[slot.done]);
+        sqe.len = static_cast<unsigned>(c.length - slot.done);
+        sqe.off = c.offset + slot.done;
+        sqe.user_data = chunk;
+        ring.sqArray[index] = index;
+        __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+        inFlight++;
+    }
+
+    // Hand the queued reads to the kernel, waiting for at least
+    // minComplete of them to finish
+    bool enter(unsigned toSubmit, unsigned minComplete) {
+        while (true) {
+            long result = syscall(__NR_io_uring_enter, ring.fd, toSubmit, minComplete,
+                                  minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) return true;
+            if (errno != EINTR) {
+                failure = string("io_uring_enter failed: ") + strerror(errno);
+                return false;
+            }
+        }
+    }
+
+    // Keep up to queueDepth reads in flight ahead of the next block to deliver
+    bool submitAhead() {
+        unsigned queued = 0;
+        while (nextSubmit < chunks.size() && nextSubmit < nextDeliver + slots.size()) {
+            Slot& slot = slots[nextSubmit % slots.size()];
+            slot.buffer.assign(chunks[nextSubmit].length, '\0');
+            slot.done = 0;
+            slot.ready = false;
+            queueRead(nextSubmit++);
+            queued++;
+        }
+        return queued == 0 || enter(queued, 0);
+    }
+
+    // Collect finished reads; a short read is queued again for the rest
+    bool reapCompletions() {
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        unsigned requeued = 0;
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+            size_t chunk = static_cast<size_t>(cqe.user_data);
+            Slot& slot = slots[chunk % slots.size()];
+            inFlight--;
+            if (cqe.res < 0) {
+                failure = "Error reading " + paths[chunks[chunk].file] + ": " + strerror(-cqe.res);
+                __atomic_store_n(ring.cqHead, head + 1, __ATOMIC_RELEASE);
+                return false;
+            }
+            slot.done += static_cast<size_t>(cqe.res);
+            if (cqe.res == 0 || slot.done == chunks[chunk].length) {
+                // a file that shrank since it was opened ends early
+                slot.buffer.resize(slot.done);
+                slot.ready = true;
+            } else {
+                queueRead(chunk);
+                requeued++;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        return requeued == 0 || enter(requeued, 0);
+    }
+
+    bool preadChunk(const Chunk& c, string& buffer) {
+        buffer.assign(c.length, '\0');
+        size_t done = 0;
+        while (done < c.length) {
+            ssize_t n = pread(fds[c.file], &buffer[done], c.length - done, static_cast<off_t>(c.offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                failure = "Error reading " + paths[c.file] + ": " + strerror(errno);
+                return false;
+            }
+            if (n == 0) break;
+            done += static_cast<size_t>(n);
+        }
+        buffer.resize(done);
+        return true;
+    }
+
+public:
+    // 4 MiB in flight: deep enough to keep a disk busy, small enough that
+    // the buffers stay in cache when the files are already in memory
+    static const size_t DEFAULT_BLOCK_SIZE = 256 << 10;
+    static const unsigned DEFAULT_QUEUE_DEPTH = 16;
+
+    // Opens every file up front; check error() before reading
+    FileBlockReader(const vector<string>& files, size_t blockSize = DEFAULT_BLOCK_SIZE,
+                    unsigned queueDepth = DEFAULT_QUEUE_DEPTH, bool useIoUring = true)
+        : paths(files), slots(max(queueDepth, 1u)) {
+        for (size_t f = 0; f < paths.size(); ++f) {
+            int fd = open(paths[f].c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat info;
+            if (fd < 0 || fstat(fd, &info) != 0) {
+                failure = "Could not open file: " + paths[f];
+                if (fd >= 0) close(fd);
+                return;
+            }
+            fds.push_back(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            size_t size = static_cast<size_t>(info.st_size);
+            bytes += size;
+            for (uint64_t offset = 0; offset < size; offset += blockSize) {
+                chunks.push_back({f, offset, min<size_t>(blockSize, size - offset)});
+            }
+        }
+        if (useIoUring) {
+            uring = setupRing(static_cast<unsigned>(slots.size()));
+            if (!uring) closeRing();
+        }
+    }
+
+    ~FileBlockReader() {
+        // the kernel may still be writing into the slot buffers
+        while (uring && inFlight > 0 && enter(0, 1)) {
+            unsigned head = *ring.cqHead;
+            unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+            inFlight -= tail - head;
+            __atomic_store_n(ring.cqHead, tail, __ATOMIC_RELEASE);
+        }
+        closeRing();
+        for (int fd : fds) close(fd);
+    }
+
+    FileBlockReader(const FileBlockReader&) = delete;
+    FileBlockReader& operator=(const FileBlockReader&) = delete;
+
+    // Next block in order; false at the end or after an error
+    bool next(Block& block) {
+        if (!failure.empty() || nextDeliver == chunks.size()) return false;
+        const Chunk& c = chunks[nextDeliver];
+        block.file = c.file;
+        block.firstOfFile = c.offset == 0;
+
+        if (!uring) {
+            if (!preadChunk(c, block.data)) return false;
+            nextDeliver++;
+            return true;
+        }
+
+        Slot& slot = slots[nextDeliver % slots.size()];
+        if (!submitAhead()) return false;
+        while (!slot.ready) {
+            if (!enter(0, 1) || !reapCompletions()) return false;
+        }
+        // the caller's old buffer becomes the slot's next one
+        block.data.swap(slot.buffer);
+        nextDeliver++;
+        // refill the slot straight away so the read-ahead stays full
+        return submitAhead();
+    }
+
+    const char* backend() const {
+        return uring ? "io_uring" : "pread";
+    }
+
+    // Total size of the files when they were opened
+    size_t totalBytes() const {
+        return bytes;
+    }
+
+    const string& error() const {
+        return failure;
+    }
+
+    // The blocks as a load pipeline source; the reader must outlive it
+    LoadPipeline::Source source() {
+        return [this](LoadPipeline::Block& block) {
+            Block next;
+            if (!this->next(next)) return false;
+            block.data = move(next.data);
+            block.firstOfFile = next.firstOfFile;
+            block.file = &paths[next.file];
+            block.inputBytes = block.data.size();
+            return true;
+        };
+    }
+};
+
+// The .csv files of a directory, sorted by name
+inline bool listCsvFiles(const string& dir, vector<string>& files, string& error) {
+    error_code code;
+    filesystem::directory_iterator it(dir, code);
+    if (code) {
+        error = "Could not open directory: " + dir;
+        return false;
+    }
+    for (const auto& entry : it) {
+        string extension = entry.path().extension().string();
+        transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (entry.is_regular_file(code) && extension == ".csv") {
+            files.push_back(entry.path().string());
+        }
+    }
+    sort(files.begin(), files.end());
+    if (files.empty()) {
+        error = "No CSV files found in " + dir;
+        return false;
+    }
+    return true;
+}
+
+#endif // FILE_BLOCK_READER_H
@@ -0,0 +1,168 @@
+#ifndef GROUP_AGGREGATES_H
+#define GROUP_AGGREGATES_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include "SalesData.h"
+#include "Sketches.h"
+#include "ResultWriter.h"
+
+using namespace std;
+
+// Running profit total per group, in the order groups were first seen
+class GroupTotals {
+private:
+    vector<pair<string, double>> totals;
+    unordered_map<string, size_t> slots;
+
+public:
+    void add(const string& group, double profit) {
+        auto it = slots.find(group);
+        if (it == slots.end()) {
+            slots.emplace(group, totals.size());
+            totals.emplace_back(group, profit);
+        } else {
+            totals[it->second].second += profit;
+        }
+    }
+
+    const vector<pair<string, double>>& get() const {
+        return totals;
+    }
+
+    // Add the other totals; its new groups go after the ones seen here
+    void merge(const GroupTotals& other) {
+        for (const auto& group : other.totals) {
+            add(group.first, group.second);
+        }
+    }
+
+    // total of one group, false if it was never seen
+    bool find(const string& group, double& total) const {
+        auto it = slots.find(group);
+        if (it == slots.end()) return false;
+        total = totals[it->second].second;
+        return true;
+    }
+
+    void clear() {
+        totals.clear();
+        slots.clear();
+    }
+};
+
+// Approximate statistics of one segment of the records: distinct Order IDs
+// and countries, and the distribution of profit
+struct SegmentSketches {
+    HyperLogLog distinctOrders;
+    HyperLogLog distinctCountries;
+    KllSketch profit;
+
+    void add(const SalesData& record) {
+        distinctOrders.add(record.orderID);
+        distinctCountries.add(record.country);
+        profit.add(record.totalProfit);
+    }
+
+    void merge(const SegmentSketches& other) {
+        distinctOrders.merge(other.distinctOrders);
+        distinctCountries.merge(other.distinctCountries);
+        profit.merge(other.profit);
+    }
+
+    size_t memoryBytes() const {
+        return distinctOrders.memoryBytes() + distinctCountries.memoryBytes() + profit.memoryBytes();
+    }
+};
+
+// Profit totals by region, country and item type, updated for every record
+// as it is inserted so the aggregation commands cost O(groups), not O(rows).
+// Sketches per region and over everything are kept up to date the same way.
+struct GroupAggregates {
+    GroupTotals byRegion;
+    GroupTotals byCountry;
+    GroupTotals byItemType;
+
+    SegmentSketches overallSketches;
+    unordered_map<string, SegmentSketches> sketchesByRegion;
+
+    void add(const SalesData& record) {
+        byRegion.add(record.region, record.totalProfit);
+        byCountry.add(record.country, record.totalProfit);
+        byItemType.add(record.itemType, record.totalProfit);
+        overallSketches.add(record);
+        sketchesByRegion[record.region].add(record);
+    }
+
+    // Combine the aggregates of two disjoint sets of records
+    void merge(const GroupAggregates& other) {
+        byRegion.merge(other.byRegion);
+        byCountry.merge(other.byCountry);
+        byItemType.merge(other.byItemType);
+        overallSketches.merge(other.overallSketches);
+        for (const auto& region : other.sketchesByRegion) {
+            sketchesByRegion[region.first].merge(region.second);
+        }
+    }
+
+    void clear() {
+        byRegion.clear();
+        byCountry.clear();
+        byItemType.clear();
+        overallSketches = SegmentSketches();
+        sketchesByRegion.clear();
+    }
+};
+
+// Output of "regions": profit per region in the order regions were first seen
+inline void writeRegionTotals(const GroupAggregates& aggregates, ResultWriter& out) {
+    out.begin("Total Profits by Region", {{"region", ""}, {"total_profit", ": $"}});
+    for(const auto& regionProfit: aggregates.byRegion.get()){
+        out.text(regionProfit.first);
+        out.money(regionProfit.second);
+        out.endRow();
+    }
+    out.end();
+}
+
+// Output of "countries": profit per country, highest first
+inline void writeCountryTotals(const GroupAggregates& aggregates, ResultWriter& out) {
+    const auto& countryMap = aggregates.byCountry.get();
+    // Sort countries by profit
+    vector<pair<string, double>> sortedProfits(countryMap.begin(), countryMap.end());
+    sort(sortedProfits.begin(), sortedProfits.end(),
+         [](const auto& a, const auto& b) { return a.second > b.second; });
+    out.begin("Total Profits by Country", {{"country", ""}, {"total_profit", ": $"}});
+    for (const auto& countryProfit : sortedProfits) {
+        out.text(countryProfit.first);
+        out.money(countryProfit.second);
+        out.endRow();
+    }
+    out.end();
+}
+
+// Output of "top_items": the n item types with the highest profit
+inline void writeTopItems(const GroupAggregates& aggregates, int n, ResultWriter& out) {
+    const auto& ItemMap = aggregates.byItemType.get();
+    // Sort items by profit
+    vector<pair<string, double>> sortedItems(
+            ItemMap.begin(), ItemMap.end()
+    );
+
+    sort(sortedItems.begin(), sortedItems.end(),
+         [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    out.begin("Top " + to_string(n) + " Performing Items",
+              {{"rank", ""}, {"item_type", ". "}, {"total_profit", ": $"}});
+    for (int i = 0; i < min(n, static_cast<int>(sortedItems.size())); ++i) {
+        out.integer(i + 1);
+        out.text(sortedItems[i].first);
+        out.money(sortedItems[i].second);
+        out.endRow();
+    }
+    out.end();
+}
+
+#endif // GROUP_AGGREGATES_H
@@ -0,0 +1,132 @@
+#ifndef HASH_BENCHMARK_H
+#define HASH_BENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <unordered_set>
+#include <algorithm>
+#include "CustomHashMap.h"
+#include "HashPolicies.h"
+
+using namespace std;
+
+// Compares the hash policies on one set of Order IDs: raw hashing speed,
+// how evenly the IDs spread over the buckets, and the find() latency of a
+// CustomHashMap using that policy for hits and for misses
+template <typename HashPolicy>
+void benchmarkHashPolicy(const vector<string>& ids, const vector<string>& absentIds) {
+    HashPolicy hasher;
+    const int REPEAT = 5;
+
+    // hashing throughput, the sink keeps the loop from being optimized away
+    size_t sink = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (int r = 0; r < REPEAT; ++r) {
+        for (const auto& id : ids) {
+            sink ^= hasher(id);
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+    double hashNs = chrono::duration<double, nano>(end - start).count() / (ids.size() * REPEAT);
+    volatile size_t keep = sink;
+    (void)keep;
+
+    // build a map with this policy, only the Order ID matters for lookups
+    CustomHashMap<HashPolicy> map;
+    for (const auto& id : ids) {
+        SalesData record{};
+        record.orderID = id;
+        record.isEmpty = false;
+        map.insert(record);
+    }
+
+    // bucket spread: dispersion index is 1 for an ideal uniform hash
+    const auto& buckets = map.getBuckets();
+    double mean = static_cast<double>(ids.size()) / buckets.size();
+    double sumSquares = 0;
+    size_t maxChain = 0;
+    for (const auto& bucket : buckets) {
+        sumSquares += static_cast<double>(bucket.size()) * bucket.size();
+        maxChain = max(maxChain, bucket.size());
+    }
+    double dispersion = (sumSquares / buckets.size() - mean * mean) / mean;
+
+    // lookups in a shuffled order so consecutive finds hit different buckets
+    vector<string> order(ids);
+    shuffle(order.begin(), order.end(), mt19937(42));
+    size_t found = 0;
+    start = chrono::high_resolution_clock::now();
+    for (const auto& id : order) {
+        if (map.find(id) != nullptr) found++;
+    }
+    end = chrono::high_resolution_clock::now();
+    double hitNs = chrono::duration<double, nano>(end - start).count() / order.size();
+
+    start = chrono::high_resolution_clock::now();
+    for (const auto& id : absentIds) {
+        if (map.find(id) != nullptr) found++;
+    }
+    end = chrono::high_resolution_clock::now();
+    double missNs = chrono::duration<double, nano>(end - start).count() / absentIds.size();
+
+    cout << fixed << setprecision(2);
+    cout << "  " << left << setw(12) << HashPolicy::name() << right
+         << setw(10) << hashNs << setw(12) << 1000.0 / hashNs
+         << setw(12) << dispersion << setw(10) << maxChain
+         << setw(12) << hitNs << setw(12) << missNs
+         << (found == ids.size() ? "" : "  (lookup mismatch)") << "\n";
+}
+
+// Run every policy over one named key set
+inline void benchmarkHashKeySet(const string& label, const vector<string>& ids,
+                                const vector<string>& absentIds) {
+    cout << "\n--- " << label << " (" << ids.size() << " keys) ---\n";
+    cout << "  " << left << setw(12) << "Policy" << right
+         << setw(10) << "ns/hash" << setw(12) << "Mkeys/s"
+         << setw(12) << "Dispersion" << setw(10) << "MaxChain"
+         << setw(12) << "Hit ns" << setw(12) << "Miss ns" << "\n";
+    benchmarkHashPolicy<PolynomialHash>(ids, absentIds);
+    benchmarkHashPolicy<Fnv1aHash>(ids, absentIds);
+    benchmarkHashPolicy<WyHash>(ids, absentIds);
+    benchmarkHashPolicy<IntegerMixHash>(ids, absentIds);
+}
+
+// Benchmark all hash policies on the loaded Order IDs and on synthetic ones
+// of the same count: consecutive IDs and uniformly random 9-digit IDs
+inline void runHashBenchmark(const vector<string>& loadedIds) {
+    size_t count = loadedIds.empty() ? 100000 : loadedIds.size();
+    mt19937_64 rng(2024);
+    uniform_int_distribution<uint64_t> nineDigits(100000000, 999999999);
+
+    vector<string> sequential, random;
+    sequential.reserve(count);
+    random.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        sequential.push_back(to_string(100000000 + i));
+        random.push_back(to_string(nineDigits(rng)));
+    }
+
+    // IDs guaranteed absent from every key set, for miss latency
+    unordered_set<string> present(loadedIds.begin(), loadedIds.end());
+    present.insert(random.begin(), random.end());
+    vector<string> absentIds;
+    absentIds.reserve(count);
+    while (absentIds.size() < count) {
+        string id = to_string(nineDigits(rng));
+        if (id >= sequential.front() && id <= sequential.back()) continue;
+        if (present.count(id) == 0) absentIds.push_back(id);
+    }
+
+    cout << "\n--- Hash Policy Benchmark ---\n";
+    if (!loadedIds.empty()) {
+        benchmarkHashKeySet("Loaded Order IDs", loadedIds, absentIds);
+    }
+    benchmarkHashKeySet("Sequential IDs", sequential, absentIds);
+    benchmarkHashKeySet("Random 9-digit IDs", random, absentIds);
+}
+
+#endif // HASH_BENCHMARK_H
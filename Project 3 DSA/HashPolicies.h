@@ -0,0 +1,93 @@
+#ifndef HASH_POLICIES_H
+#define HASH_POLICIES_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// Hash policies for CustomHashMap. Each one maps an Order ID to a full
+// 64-bit hash, the map reduces it to a bucket index itself.
+
+// The original hash: polynomial over the characters with base 31.
+// Taking it modulo a power of two bucket count gives the same index as
+// reducing after every character did before.
+struct PolynomialHash {
+    static const char* name() { return "polynomial"; }
+
+    size_t operator()(const string& key) const {
+        size_t hash = 0;
+        for (char c : key) {
+            hash = hash * 31 + c;
+        }
+        return hash;
+    }
+};
+
+// FNV-1a, one xor and one multiply per byte
+struct Fnv1aHash {
+    static const char* name() { return "fnv1a"; }
+
+    size_t operator()(const string& key) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+};
+
+// wyhash style: consume 8 bytes at a time and fold each block with a
+// 64x64 -> 128 bit multiply
+struct WyHash {
+    static const char* name() { return "wyhash"; }
+
+    static uint64_t mum(uint64_t a, uint64_t b) {
+        __uint128_t r = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+    }
+
+    size_t operator()(const string& key) const {
+        const uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL, s2 = 0x8ebc6af09c88c6e3ULL;
+        const char* p = key.data();
+        size_t len = key.size();
+        uint64_t seed = s0 ^ len;
+        while (len >= 8) {
+            uint64_t block;
+            memcpy(&block, p, 8);
+            seed = mum(block ^ s1, seed ^ s0);
+            p += 8;
+            len -= 8;
+        }
+        uint64_t tail = 0;
+        memcpy(&tail, p, len);
+        // fold the tail, then mix once more so short keys spread over all 64 bits
+        uint64_t hash = mum(tail ^ s1, seed ^ s2);
+        return mum(hash ^ s0, s1 ^ key.size());
+    }
+};
+
+// Order IDs are 9-10 digit numbers: parse them and run the splitmix64
+// finalizer over the value. Anything that is not all digits falls back to FNV-1a.
+struct IntegerMixHash {
+    static const char* name() { return "intmix"; }
+
+    size_t operator()(const string& key) const {
+        if (key.empty() || key.size() > 19) return Fnv1aHash()(key);
+        uint64_t x = 0;
+        for (char c : key) {
+            if (c < '0' || c > '9') return Fnv1aHash()(key);
+            x = x * 10 + (c - '0');
+        }
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+};
+
+#endif // HASH_POLICIES_H
@@ -0,0 +1,125 @@
+#ifndef INVERTED_INDEX_H
+#define INVERTED_INDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "SalesTable.h"
+
+using namespace std;
+
+// A sorted run of record IDs inside an InvertedIndex
+struct PostingList {
+    const uint32_t* first;
+    const uint32_t* last;
+
+    size_t size() const {
+        return last - first;
+    }
+};
+
+// Secondary index over one dimension of a SalesTable: for every dictionary
+// code, the sorted IDs of the records that have it. All lists share one
+// array (offsets[code] .. offsets[code + 1]) instead of one vector per value.
+class InvertedIndex {
+private:
+    vector<uint32_t> offsets;
+    vector<uint32_t> recordIDs;
+
+public:
+    // Counting sort of the record IDs by code; IDs are visited in order so
+    // every list comes out sorted
+    void build(const vector<uint16_t>& codes, size_t cardinality) {
+        offsets.assign(cardinality + 1, 0);
+        for (uint16_t code : codes) {
+            offsets[code + 1]++;
+        }
+        for (size_t c = 0; c < cardinality; ++c) {
+            offsets[c + 1] += offsets[c];
+        }
+        recordIDs.resize(codes.size());
+        vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+        for (uint32_t id = 0; id < codes.size(); ++id) {
+            recordIDs[next[codes[id]]++] = id;
+        }
+    }
+
+    PostingList postings(uint16_t code) const {
+        if (code + 1 >= static_cast<int>(offsets.size())) return {nullptr, nullptr};
+        return {recordIDs.data() + offsets[code], recordIDs.data() + offsets[code + 1]};
+    }
+
+    size_t memoryBytes() const {
+        return (offsets.size() + recordIDs.size()) * sizeof(uint32_t);
+    }
+
+    // Intersect two sorted lists. When one is much shorter, gallop through
+    // the long one so the cost follows the short list instead of both.
+    static vector<uint32_t> intersect(const uint32_t* a, const uint32_t* aEnd,
+                                      const uint32_t* b, const uint32_t* bEnd) {
+        if (aEnd - a > bEnd - b) {
+            swap(a, b);
+            swap(aEnd, bEnd);
+        }
+        vector<uint32_t> result;
+        if ((bEnd - b) > 32 * (aEnd - a)) {
+            for (; a != aEnd && b != bEnd; ++a) {
+                // exponential search for the range holding *a, then binary search
+                size_t step = 1;
+                while (b + step < bEnd && b[step] < *a) step *= 2;
+                b = lower_bound(b + step / 2, min(b + step + 1, bEnd), *a);
+                if (b != bEnd && *b == *a) result.push_back(*a);
+            }
+        } else {
+            while (a != aEnd && b != bEnd) {
+                if (*a < *b) ++a;
+                else if (*b < *a) ++b;
+                else {
+                    result.push_back(*a);
+                    ++a;
+                    ++b;
+                }
+            }
+        }
+        return result;
+    }
+
+    // Intersect any number of lists, shortest first so the running result
+    // only ever shrinks
+    static vector<uint32_t> intersectAll(vector<PostingList> lists) {
+        if (lists.empty()) return {};
+        sort(lists.begin(), lists.end(),
+             [](const PostingList& x, const PostingList& y) { return x.size() < y.size(); });
+        vector<uint32_t> result(lists[0].first, lists[0].last);
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            result = intersect(result.data(), result.data() + result.size(), lists[i].first, lists[i].last);
+        }
+        return result;
+    }
+};
+
+// One inverted index per dimension of a SalesTable
+class SecondaryIndexes {
+private:
+    InvertedIndex indexes[NUM_DIMENSIONS];
+
+public:
+    void build(const SalesTable& table) {
+        for (int d = 0; d < NUM_DIMENSIONS; ++d) {
+            Dimension dim = static_cast<Dimension>(d);
+            indexes[d].build(table.codes(dim), table.dictionary(dim).size());
+        }
+    }
+
+    const InvertedIndex& index(Dimension dim) const {
+        return indexes[static_cast<int>(dim)];
+    }
+
+    size_t memoryBytes() const {
+        size_t total = 0;
+        for (const auto& index : indexes) total += index.memoryBytes();
+        return total;
+    }
+};
+
+#endif // INVERTED_INDEX_H
@@ -0,0 +1,126 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <unistd.h>
+#include "QueryServer.h"
+
+using namespace std;
+
+// Closed-loop load generator for QueryServer: every client thread keeps one
+// connection and sends the next command as soon as the previous response
+// has arrived, cycling through the command list from its own offset.
+class LoadGenerator {
+private:
+    struct ClientResult {
+        vector<long long> latencies; // nanoseconds per request
+        size_t failures = 0;
+        string error;
+    };
+
+    // Send one command and read up to the "." line ending its response
+    static bool roundTrip(int fd, const string& command, string& buffer) {
+        string line = command + "\n";
+        size_t sent = 0;
+        while (sent < line.size()) {
+            ssize_t n = write(fd, line.data() + sent, line.size() - sent);
+            if (n <= 0) return false;
+            sent += n;
+        }
+        buffer.clear();
+        char chunk[16384];
+        while (true) {
+            if (buffer.size() >= 2 && buffer.compare(buffer.size() - 2, 2, ".\n") == 0 &&
+                (buffer.size() == 2 || buffer[buffer.size() - 3] == '\n')) {
+                return true;
+            }
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) return false;
+            buffer.append(chunk, n);
+        }
+    }
+
+    static void runClient(const string& address, const vector<string>& commands, size_t offset,
+                          size_t requests, ClientResult& result) {
+        int fd = connectTo(address, result.error);
+        if (fd < 0) {
+            result.failures = requests;
+            return;
+        }
+        result.latencies.reserve(requests);
+        string buffer;
+        for (size_t i = 0; i < requests; ++i) {
+            const string& command = commands[(offset + i) % commands.size()];
+            auto start = std::chrono::high_resolution_clock::now();
+            if (!roundTrip(fd, command, buffer)) {
+                result.failures += requests - i;
+                result.error = "connection closed by server";
+                break;
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+        close(fd);
+    }
+
+    static long long percentile(const vector<long long>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[min(index, sorted.size() - 1)];
+    }
+
+public:
+    // Run clients x requestsPerClient requests and print throughput and
+    // latency percentiles
+    static void run(const string& address, const vector<string>& commands, size_t clients,
+                    size_t requestsPerClient) {
+        vector<ClientResult> results(clients);
+        vector<thread> threads;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t c = 0; c < clients; ++c) {
+            size_t offset = c * commands.size() / clients;
+            threads.emplace_back(runClient, cref(address), cref(commands), offset, requestsPerClient,
+                                 ref(results[c]));
+        }
+        for (auto& t : threads) t.join();
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e9;
+
+        vector<long long> latencies;
+        size_t failures = 0;
+        for (const auto& result : results) {
+            latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+            failures += result.failures;
+            if (!result.error.empty()) {
+                cerr << "Client error: " << result.error << "\n";
+            }
+        }
+        sort(latencies.begin(), latencies.end());
+        double mean = 0;
+        for (long long l : latencies) mean += l;
+        if (!latencies.empty()) mean /= latencies.size();
+
+        cout << "\n--- Load Generator ---\n";
+        cout << "Server:            " << address << "\n";
+        cout << "Clients:           " << clients << "\n";
+        cout << "Requests:          " << latencies.size() << " (" << failures << " failed)\n";
+        cout << fixed << setprecision(2);
+        cout << "Wall time (s):     " << seconds << "\n";
+        cout << "Throughput (QPS):  " << latencies.size() / max(seconds, 1e-9) << "\n";
+        cout << "Latency (microseconds):\n";
+        cout << "  mean   " << mean / 1000 << "\n";
+        cout << "  p50    " << percentile(latencies, 50) / 1000.0 << "\n";
+        cout << "  p90    " << percentile(latencies, 90) / 1000.0 << "\n";
+        cout << "  p99    " << percentile(latencies, 99) / 1000.0 << "\n";
+        cout << "  p99.9  " << percentile(latencies, 99.9) / 1000.0 << "\n";
+        cout << "  max    " << (latencies.empty() ? 0 : latencies.back()) / 1000.0 << "\n";
+    }
+};
+
+#endif // LOAD_GENERATOR_H
@@ -0,0 +1,347 @@
+#ifndef LOAD_PIPELINE_H
+#define LOAD_PIPELINE_H
+
+#include <iostream>
+#include <iomanip>
+#include <istream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include "SalesData.h"
+
+using namespace std;
+
+// Fixed-capacity queue between two pipeline stages: push waits while it is
+// full, pop waits while it is empty and fails once it is closed and drained
+template <typename T>
+class BoundedQueue {
+private:
+    deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    mutex lock;
+    condition_variable notFull;
+    condition_variable notEmpty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(T item) {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [this] { return items.size() < capacity; });
+        items.push_back(move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T& item) {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // No more pushes; consumers finish what is queued
+    void close() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        notEmpty.notify_all();
+    }
+};
+
+// Parse one CSV row in the column order of the sales file. Throws like
+// stoi/stod on a malformed number.
+inline void parseSalesLine(const string& line, SalesData& record) {
+    string* text[8] = {&record.region, &record.country, &record.itemType, &record.salesChannel,
+                       &record.orderPriority, &record.orderDate, &record.orderID, &record.shipDate};
+    string numbers[6];
+    size_t start = 0;
+    for (int f = 0; f < 14; ++f) {
+        size_t comma = f < 13 ? line.find(',', start) : string::npos;
+        size_t end = comma == string::npos ? line.size() : comma;
+        if (f < 8) text[f]->assign(line, start, end - start);
+        else numbers[f - 8].assign(line, start, end - start);
+        if (comma == string::npos) break;
+        start = comma + 1;
+    }
+    record.unitsSold = stoi(numbers[0]);
+    record.unitPrice = stod(numbers[1]);
+    record.unitCost = stod(numbers[2]);
+    record.totalRevenue = stod(numbers[3]);
+    record.totalCost = stod(numbers[4]);
+    record.totalProfit = stod(numbers[5]);
+    // current record is no longer empty
+    record.isEmpty = false;
+}
+
+// Loads CSV data in four stages connected by bounded queues, each on its
+// own thread(s):
+//   read   - pulls large blocks from a source (a stream or a set of files)
+//   split  - cuts blocks into batches of whole lines (skipping each header)
+//   parse  - a group of threads turns line batches into records
+//   insert - the calling thread hands parsed batches to the sink in file order
+// Every stage times the work it does (not the time it waits on a queue), so
+// report() shows which one limits the load.
+class LoadPipeline {
+public:
+    typedef function<void(vector<SalesData>&)> Sink;
+
+    // Raw bytes of one or more CSV files. A block that starts a new file
+    // says so, and file names it for error messages (null for one stream).
+    // inputBytes is how much of the file on disk it took, which is less
+    // than its size for a compressed file.
+    struct Block {
+        string data;
+        bool firstOfFile = false;
+        const string* file = nullptr;
+        size_t inputBytes = 0;
+    };
+    // Fills the next block; false at the end of the data
+    typedef function<bool(Block&)> Source;
+
+    struct Stats {
+        size_t bytes = 0;
+        size_t rows = 0;
+        size_t errors = 0;
+        size_t parseThreads = 0;
+        long long wallNs = 0;
+        long long busyNs[4] = {0, 0, 0, 0}; // read, split, parse (all threads), insert
+    };
+
+private:
+    static const size_t READ_BLOCK_SIZE = 1 << 20;
+    static const size_t LINES_PER_BATCH = 4096;
+
+    struct LineBatch {
+        size_t sequence;
+        size_t firstLine; // 1-based line number in the file
+        const string* file;
+        vector<string> lines;
+    };
+
+    struct RecordBatch {
+        size_t sequence;
+        vector<SalesData> records;
+        vector<string> errors;
+    };
+
+    size_t parseThreads;
+    Stats stats;
+
+    static long long nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(
+                chrono::high_resolution_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    explicit LoadPipeline(size_t parseThreads = max(2u, thread::hardware_concurrency()))
+        : parseThreads(max<size_t>(parseThreads, 1)) {}
+
+    // Source reading a stream in large blocks
+    static Source streamSource(istream& in) {
+        return [&in, first = true](Block& block) mutable {
+            block.firstOfFile = first;
+            first = false;
+            block.data.assign(READ_BLOCK_SIZE, '\0');
+            in.read(&block.data[0], READ_BLOCK_SIZE);
+            block.data.resize(static_cast<size_t>(in.gcount()));
+            block.inputBytes = block.data.size();
+            return !block.data.empty();
+        };
+    }
+
+    // Load everything the source gives. sink gets the records in file order,
+    // in batches; parse errors go to err. bytesRead is updated as blocks are
+    // read and the read stage stops early once cancel is set.
+    void run(const Source& source, const Sink& sink, ostream& err, atomic<size_t>& bytesRead,
+             const atomic<bool>& cancel) {
+        stats = Stats();
+        stats.parseThreads = parseThreads;
+        long long start = nowNs();
+        BoundedQueue<Block> blocks(8);
+        BoundedQueue<LineBatch> lineBatches(4 * parseThreads);
+        BoundedQueue<RecordBatch> recordBatches(4 * parseThreads);
+        atomic<long long> parseBusy{0};
+
+        thread reader([&] {
+            long long busy = 0;
+            while (!cancel) {
+                long long t0 = nowNs();
+                Block block;
+                bool more = source(block);
+                busy += nowNs() - t0;
+                if (!more) break;
+                stats.bytes += block.data.size();
+                bytesRead += block.inputBytes;
+                blocks.push(move(block));
+            }
+            blocks.close();
+            stats.busyNs[0] = busy;
+        });
+
+        thread splitter([&] {
+            long long busy = 0;
+            string carry;
+            size_t lineNumber = 0, sequence = 0;
+            const string* file = nullptr;
+            LineBatch batch{0, 1, nullptr, {}};
+            batch.lines.reserve(LINES_PER_BATCH);
+            auto addLine = [&](string&& line) {
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                lineNumber++;
+                if (lineNumber == 1) return; // header
+                if (batch.lines.empty()) {
+                    batch.firstLine = lineNumber;
+                    batch.file = file;
+                }
+                batch.lines.push_back(move(line));
+            };
+            // hand the current batch on; the push itself counts as waiting
+            auto flush = [&] {
+                if (batch.lines.empty()) return;
+                batch.sequence = sequence++;
+                LineBatch full = move(batch);
+                batch = LineBatch{0, 0, nullptr, {}};
+                batch.lines.reserve(LINES_PER_BATCH);
+                lineBatches.push(move(full));
+            };
+            Block next;
+            while (blocks.pop(next)) {
+                if (next.firstOfFile) {
+                    // the previous file may end without a newline
+                    if (!carry.empty()) addLine(move(carry));
+                    carry.clear();
+                    flush();
+                    lineNumber = 0;
+                    file = next.file;
+                }
+                const string& block = next.data;
+                long long t0 = nowNs();
+                size_t start = 0;
+                size_t newline;
+                while ((newline = block.find('\n', start)) != string::npos) {
+                    // a line cut by the block boundary is finished from carry
+                    if (carry.empty()) {
+                        addLine(block.substr(start, newline - start));
+                    } else {
+                        carry.append(block, start, newline - start);
+                        addLine(move(carry));
+                        carry.clear();
+                    }
+                    start = newline + 1;
+                    if (batch.lines.size() == LINES_PER_BATCH) {
+                        busy += nowNs() - t0;
+                        flush();
+                        t0 = nowNs();
+                    }
+                }
+                carry.append(block, start, string::npos);
+                busy += nowNs() - t0;
+            }
+            if (!carry.empty()) addLine(move(carry));
+            flush();
+            lineBatches.close();
+            stats.busyNs[1] = busy;
+        });
+
+        vector<thread> parsers;
+        atomic<size_t> parsersLeft{parseThreads};
+        for (size_t p = 0; p < parseThreads; ++p) {
+            parsers.emplace_back([&] {
+                long long busy = 0;
+                LineBatch batch;
+                while (lineBatches.pop(batch)) {
+                    long long t0 = nowNs();
+                    RecordBatch parsed;
+                    parsed.sequence = batch.sequence;
+                    parsed.records.reserve(batch.lines.size());
+                    for (size_t i = 0; i < batch.lines.size(); ++i) {
+                        SalesData record;
+                        try {
+                            parseSalesLine(batch.lines[i], record);
+                            parsed.records.push_back(move(record));
+                        } catch (const exception& e) {
+                            parsed.errors.push_back("Error parsing line " + to_string(batch.firstLine + i) +
+                                                    (batch.file ? " of " + *batch.file : "") + ": " +
+                                                    batch.lines[i] + "\nException: " + e.what() + "\n");
+                        }
+                    }
+                    busy += nowNs() - t0;
+                    recordBatches.push(move(parsed));
+                }
+                parseBusy += busy;
+                if (--parsersLeft == 0) recordBatches.close();
+            });
+        }
+
+        // insert stage on the calling thread, putting batches back in order
+        long long insertBusy = 0;
+        map<size_t, RecordBatch> early;
+        size_t nextSequence = 0;
+        RecordBatch parsed;
+        while (recordBatches.pop(parsed)) {
+            early.emplace(parsed.sequence, move(parsed));
+            for (auto it = early.find(nextSequence); it != early.end(); it = early.find(++nextSequence)) {
+                long long t0 = nowNs();
+                for (const string& error : it->second.errors) err << error;
+                stats.errors += it->second.errors.size();
+                stats.rows += it->second.records.size();
+                sink(it->second.records);
+                insertBusy += nowNs() - t0;
+                early.erase(it);
+            }
+        }
+
+        reader.join();
+        splitter.join();
+        for (auto& parser : parsers) parser.join();
+        stats.busyNs[2] = parseBusy;
+        stats.busyNs[3] = insertBusy;
+        stats.wallNs = nowNs() - start;
+    }
+
+    const Stats& lastStats() const {
+        return stats;
+    }
+
+    // Per-stage busy time and throughput of a load. A stage's throughput is
+    // what it managed per second of its own work; the slowest one bounds
+    // the whole load.
+    static void report(const Stats& stats) {
+        const char* names[4] = {"read", "split", "parse", "insert"};
+        size_t threads[4] = {1, 1, stats.parseThreads, 1};
+        double mb = stats.bytes / 1e6;
+        cout << "\n--- Load Pipeline ---\n";
+        cout << "Rows: " << stats.rows << ", bytes: " << stats.bytes << ", parse errors: " << stats.errors << "\n";
+        cout << left << setw(8) << "Stage" << right << setw(9) << "Threads" << setw(12) << "Busy (ms)"
+             << setw(12) << "Busy (%)" << setw(14) << "MB/s" << setw(14) << "rows/s" << "\n";
+        int slowest = 0;
+        double slowestNs = 0;
+        cout << fixed << setprecision(1);
+        for (int s = 0; s < 4; ++s) {
+            // wall-clock time the stage needs with all its threads busy
+            double stageNs = static_cast<double>(stats.busyNs[s]) / threads[s];
+            if (stageNs > slowestNs) {
+                slowestNs = stageNs;
+                slowest = s;
+            }
+            double seconds = max(stageNs, 1.0) / 1e9;
+            cout << left << setw(8) << names[s] << right << setw(9) << threads[s]
+                 << setw(12) << stats.busyNs[s] / 1e6 << setw(12) << 100.0 * stageNs / max<long long>(stats.wallNs, 1)
+                 << setw(14) << mb / seconds << setw(14) << stats.rows / seconds << "\n";
+        }
+        cout << "Wall time (ms): " << stats.wallNs / 1e6 << ", slowest stage: " << names[slowest]
+             << " (" << slowestNs / 1e6 << " ms)\n";
+    }
+};
+
+#endif // LOAD_PIPELINE_H
@@ -0,0 +1,130 @@
+#ifndef ORDER_ID_INDEX_H
+#define ORDER_ID_INDEX_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include "SalesTable.h"
+
+using namespace std;
+
+// Order IDs are numeric; false if the string is not a plain number
+inline bool parseOrderID(const string& orderID, uint64_t& value) {
+    if (orderID.empty() || orderID.size() > 19) return false;
+    value = 0;
+    for (char c : orderID) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+// Static sorted index on Order ID, built after a load, for range scans and
+// predecessor/successor queries the hash map cannot answer.
+// The keys are kept twice: in sorted order for scanning, and in Eytzinger
+// (BFS) layout for searching. In that layout the children of slot k are 2k
+// and 2k+1, so the first levels of the search share a few cache lines, the
+// loop has no unpredictable branch, and the next levels can be prefetched.
+class OrderIdIndex {
+private:
+    // sorted order
+    vector<uint64_t> keys;
+    vector<uint32_t> rows;
+
+    // 1-based Eytzinger layout and the sorted position of every slot
+    vector<uint64_t> eytzinger;
+    vector<uint32_t> eytzingerRank;
+
+    // fill the tree in order: an in-order walk of the implicit tree visits
+    // the keys sorted
+    size_t fill(size_t i, size_t k) {
+        if (k < eytzinger.size()) {
+            i = fill(i, 2 * k);
+            eytzinger[k] = keys[i];
+            eytzingerRank[k] = static_cast<uint32_t>(i);
+            i++;
+            i = fill(i, 2 * k + 1);
+        }
+        return i;
+    }
+
+public:
+    void build(const SalesTable& table) {
+        vector<pair<uint64_t, uint32_t>> entries;
+        entries.reserve(table.size());
+        for (uint32_t row = 0; row < table.size(); ++row) {
+            uint64_t key;
+            if (parseOrderID(table.rows[row]->orderID, key)) {
+                entries.emplace_back(key, row);
+            }
+        }
+        sort(entries.begin(), entries.end());
+
+        keys.resize(entries.size());
+        rows.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            keys[i] = entries[i].first;
+            rows[i] = entries[i].second;
+        }
+
+        eytzinger.assign(keys.size() + 1, 0);
+        eytzingerRank.assign(keys.size() + 1, 0);
+        fill(0, 1);
+    }
+
+    size_t size() const {
+        return keys.size();
+    }
+
+    // Sorted position of the first key >= value, size() if there is none
+    size_t lowerBound(uint64_t value) const {
+        size_t n = keys.size();
+        size_t k = 1;
+        while (k <= n) {
+            // 16 keys of 8 bytes = two cache lines, four levels ahead
+            __builtin_prefetch(eytzinger.data() + min(16 * k, n));
+            k = 2 * k + (eytzinger[k] < value);
+        }
+        // undo the trailing right turns (and the one left turn before them)
+        k >>= __builtin_ffsll(~k);
+        return k == 0 ? n : eytzingerRank[k];
+    }
+
+    uint64_t keyAt(size_t position) const {
+        return keys[position];
+    }
+
+    uint32_t rowAt(size_t position) const {
+        return rows[position];
+    }
+
+    // Row of an exact Order ID, -1 if absent
+    long long find(uint64_t value) const {
+        size_t position = lowerBound(value);
+        if (position < keys.size() && keys[position] == value) return rows[position];
+        return -1;
+    }
+
+    // Sorted positions [first, last) of the keys in [low, high]
+    pair<size_t, size_t> range(uint64_t low, uint64_t high) const {
+        if (low > high) return {0, 0};
+        size_t first = lowerBound(low);
+        size_t last = high == UINT64_MAX ? keys.size() : lowerBound(high + 1);
+        return {first, last};
+    }
+
+    // Position of the largest key < value, -1 if none
+    long long predecessor(uint64_t value) const {
+        return static_cast<long long>(lowerBound(value)) - 1;
+    }
+
+    // Position of the smallest key > value, -1 if none
+    long long successor(uint64_t value) const {
+        if (value == UINT64_MAX) return -1;
+        size_t position = lowerBound(value + 1);
+        return position < keys.size() ? static_cast<long long>(position) : -1;
+    }
+};
+
+#endif // ORDER_ID_INDEX_H
@@ -0,0 +1,155 @@
+#ifndef POOL_BENCHMARK_H
+#define POOL_BENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <atomic>
+#include "ThreadPool.h"
+#include "CustomHashMap.h"
+#include "max_heap.h"
+
+using namespace std;
+
+template <typename Work>
+double timeNs(const Work& work) {
+    auto start = chrono::high_resolution_clock::now();
+    work();
+    auto end = chrono::high_resolution_clock::now();
+    return chrono::duration<double, nano>(end - start).count();
+}
+
+// Cost of spawning tasks on the shared pool: from outside the pool, nested
+// from inside it, and as parallelFor chunks
+inline void benchmarkTaskSpawn() {
+    ThreadPool& pool = ThreadPool::shared();
+    const size_t TASKS = 200000;
+    atomic<size_t> counter{0};
+
+    double flatNs = timeNs([&] {
+        TaskGroup group(pool);
+        for (size_t i = 0; i < TASKS; ++i) {
+            group.run([&counter] { counter.fetch_add(1, memory_order_relaxed); });
+        }
+        group.wait();
+    });
+
+    // 1000 tasks that each spawn 200 more from a worker's own deque
+    double nestedNs = timeNs([&] {
+        TaskGroup outer(pool);
+        for (size_t i = 0; i < TASKS / 200; ++i) {
+            outer.run([&pool, &counter] {
+                TaskGroup inner(pool);
+                for (int j = 0; j < 199; ++j) {
+                    inner.run([&counter] { counter.fetch_add(1, memory_order_relaxed); });
+                }
+                inner.wait();
+            });
+        }
+        outer.wait();
+    });
+
+    double forNs = timeNs([&] {
+        parallelFor(pool, 0, TASKS, 1, [&counter](size_t first, size_t last) {
+            counter.fetch_add(last - first, memory_order_relaxed);
+        });
+    });
+
+    cout << "Task spawn overhead (shared pool, " << pool.size() << " workers):\n";
+    cout << fixed << setprecision(1);
+    cout << "  submitted from outside:  " << flatNs / TASKS << " ns per task\n";
+    cout << "  spawned inside workers:  " << nestedNs / TASKS << " ns per task\n";
+    cout << "  parallelFor grain 1:     " << forNs / TASKS << " ns per chunk\n";
+}
+
+// Speedup of compute-bound and memory-bound loops, the hash map scan and
+// the heap build over a sequential run, for pools of 1 to maxWorkers workers.
+// The map scan covers every shard's map, one after the other.
+inline void runPoolBenchmark(const vector<const CustomHashMap<>*>& maps, const vector<SalesData>& records,
+                             size_t maxWorkers) {
+    cout << "\n--- Thread Pool Benchmark ---\n";
+    cout << "Hardware threads: " << thread::hardware_concurrency() << "\n";
+    benchmarkTaskSpawn();
+
+    // sequential baselines
+    const size_t N = 4000000;
+    vector<double> values(N);
+    for (size_t i = 0; i < N; ++i) values[i] = static_cast<double>(i % 1000);
+    auto computeChunk = [](size_t first, size_t last) {
+        double sum = 0;
+        for (size_t i = first; i < last; ++i) sum += sqrt(static_cast<double>(i)) * sin(static_cast<double>(i));
+        return sum;
+    };
+    auto memoryChunk = [&values](size_t first, size_t last) {
+        double sum = 0;
+        for (size_t i = first; i < last; ++i) sum += values[i];
+        return sum;
+    };
+    volatile double sink = 0;
+    double computeSeq = timeNs([&] { sink = sink + computeChunk(0, N); });
+    double memorySeq = timeNs([&] { sink = sink + memoryChunk(0, N); });
+    double scanSeq = timeNs([&] {
+        const SalesData* best = nullptr;
+        for (const auto* map : maps) {
+            for (const auto& bucket : map->getBuckets()) {
+                for (const auto& record : bucket) {
+                    if (best == nullptr || record.totalProfit > best->totalProfit) best = &record;
+                }
+            }
+        }
+        sink = sink + (best ? best->totalProfit : 0);
+    });
+    max_heap heap;
+    vector<SalesData> copy(records);
+    double buildSeq = timeNs([&] { heap.build(move(copy)); });
+
+    cout << "Sequential (ms): compute " << computeSeq / 1e6 << ", memory " << memorySeq / 1e6
+         << ", map scan " << scanSeq / 1e6 << ", heap build " << buildSeq / 1e6 << "\n";
+    cout << "Speedup over sequential (efficiency per thread in brackets); threads = workers + caller\n";
+    cout << left << setw(9) << "Workers" << setw(20) << "compute" << setw(20) << "memory"
+         << setw(20) << "map scan" << "heap build\n";
+
+    for (size_t workers = 1; workers <= maxWorkers; workers *= 2) {
+        ThreadPool pool(workers);
+        size_t threads = workers + 1;
+        double computeNs = timeNs([&] {
+            sink = sink + parallelReduce<double>(pool, 0, N, defaultGrain(N, pool), 0.0, computeChunk,
+                                                 [](double a, double b) { return a + b; });
+        });
+        double memoryNs = timeNs([&] {
+            sink = sink + parallelReduce<double>(pool, 0, N, defaultGrain(N, pool), 0.0, memoryChunk,
+                                                 [](double a, double b) { return a + b; });
+        });
+        double scanNs = timeNs([&] {
+            const SalesData* best = nullptr;
+            for (const auto* map : maps) {
+                const SalesData* shardBest = map->findHighestProfitRecord(pool);
+                if (shardBest != nullptr && (best == nullptr || shardBest->totalProfit > best->totalProfit)) {
+                    best = shardBest;
+                }
+            }
+            sink = sink + (best ? best->totalProfit : 0);
+        });
+        vector<SalesData> buildCopy(records);
+        double buildNs = timeNs([&] { heap.build(move(buildCopy), &pool); });
+
+        cout << left << setw(9) << workers;
+        const double seq[4] = {computeSeq, memorySeq, scanSeq, buildSeq};
+        const double par[4] = {computeNs, memoryNs, scanNs, buildNs};
+        for (int k = 0; k < 4; ++k) {
+            ostringstream cell;
+            double speedup = seq[k] / par[k];
+            cell << fixed << setprecision(2) << speedup << "x (" << setprecision(0)
+                 << 100 * speedup / threads << "%)";
+            cout << setw(k < 3 ? 20 : 0) << cell.str();
+        }
+        cout << "\n";
+    }
+    cout << right;
+}
+
+#endif // POOL_BENCHMARK_H
@@ -0,0 +1,46 @@
+#ifndef PROFIT_RANKS_H
+#define PROFIT_RANKS_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "SalesTable.h"
+
+using namespace std;
+
+// Order statistics over totalProfit, built after a load: every profit in
+// ascending order. The rank of a profit is two binary searches and the
+// value at a percentile is a single array read.
+class ProfitRanks {
+private:
+    vector<double> sortedProfits;
+
+public:
+    void build(const SalesTable& table) {
+        sortedProfits = table.totalProfit;
+        sort(sortedProfits.begin(), sortedProfits.end());
+    }
+
+    size_t size() const {
+        return sortedProfits.size();
+    }
+
+    // number of orders with a profit strictly below / above the value
+    size_t countBelow(double profit) const {
+        return lower_bound(sortedProfits.begin(), sortedProfits.end(), profit) - sortedProfits.begin();
+    }
+
+    size_t countAbove(double profit) const {
+        return sortedProfits.end() - upper_bound(sortedProfits.begin(), sortedProfits.end(), profit);
+    }
+
+    // Nearest-rank percentile, p in [0, 100]
+    double percentile(double p) const {
+        if (sortedProfits.empty()) return 0;
+        size_t n = sortedProfits.size();
+        size_t rank = static_cast<size_t>(ceil(p / 100.0 * n));
+        return sortedProfits[rank == 0 ? 0 : min(rank, n) - 1];
+    }
+};
+
+#endif // PROFIT_RANKS_H
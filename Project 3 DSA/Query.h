@@ -0,0 +1,511 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include "SalesTable.h"
+#include "InvertedIndex.h"
+#include "ResultWriter.h"
+
+using namespace std;
+
+// Small aggregate query language over the SalesTable, e.g.
+//   query sum(totalProfit), count(*) where region=Europe and channel=Online
+//         and priority=H and year>2015 group by itemType
+// The text is compiled once into a list of column predicates and aggregates.
+// Execution keeps a selection vector of matching record IDs: the most
+// selective predicate produces it (from its posting list when it is an
+// equality on an indexed column) and every further predicate narrows it
+// with a tight loop over just its own column.
+class Query {
+private:
+    enum class Aggregate { Sum, Avg, Min, Max, Count };
+    enum class Column { Profit, Revenue, Cost, Units, OrderDate };
+
+    struct AggregateSpec {
+        Aggregate function;
+        Column column;
+        string label;
+    };
+
+    // either dictionary code set membership or an inclusive numeric range
+    struct Predicate {
+        string label;
+        bool isDimension;
+        Dimension dim;
+        vector<bool> codes;       // dimension: which codes pass
+        int code = -1;            // dimension: single code for "=", for the index
+        Column column;            // numeric
+        double low, high;         // numeric, inclusive
+        bool negate = false;
+        double selectivity = 1;   // estimated fraction of rows that pass
+    };
+
+    struct Token {
+        enum Kind { Word, Text, Symbol, End } kind;
+        string text;
+    };
+
+    const SalesTable* table = nullptr;
+    const SecondaryIndexes* indexes = nullptr;
+    vector<AggregateSpec> aggregates;
+    vector<Predicate> predicates;
+    bool grouped = false;
+    Dimension groupBy = Dimension::Region;
+
+    // ---- parsing ----
+
+    static vector<Token> tokenize(const string& text) {
+        vector<Token> tokens;
+        size_t i = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else if (c == '"' || c == '\'') {
+                size_t end = text.find(c, i + 1);
+                if (end == string::npos) end = text.size();
+                tokens.push_back({Token::Text, text.substr(i + 1, end - i - 1)});
+                i = end + 1;
+            } else if (isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '-' || c == '/') {
+                size_t start = i;
+                while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_' ||
+                                           text[i] == '.' || text[i] == '-' || text[i] == '/')) {
+                    i++;
+                }
+                tokens.push_back({Token::Word, text.substr(start, i - start)});
+            } else if ((c == '!' || c == '<' || c == '>') && i + 1 < text.size() && text[i + 1] == '=') {
+                tokens.push_back({Token::Symbol, text.substr(i, 2)});
+                i += 2;
+            } else {
+                tokens.push_back({Token::Symbol, string(1, c)});
+                i++;
+            }
+        }
+        tokens.push_back({Token::End, ""});
+        return tokens;
+    }
+
+    static string lower(string s) {
+        for (auto& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    static bool isKeyword(const Token& token, const char* keyword) {
+        return token.kind == Token::Word && lower(token.text) == keyword;
+    }
+
+    static bool parseColumn(const string& name, Column& column) {
+        string n = lower(name);
+        if (n == "totalprofit" || n == "profit") column = Column::Profit;
+        else if (n == "totalrevenue" || n == "revenue") column = Column::Revenue;
+        else if (n == "totalcost" || n == "cost") column = Column::Cost;
+        else if (n == "unitssold" || n == "units") column = Column::Units;
+        else return false;
+        return true;
+    }
+
+    // "2015-06-01" or "6/1/2015" as YYYYMMDD
+    static bool parseDateValue(const string& text, double& value) {
+        int year, month, day;
+        if (sscanf(text.c_str(), "%d-%d-%d", &year, &month, &day) == 3 ||
+            (sscanf(text.c_str(), "%d/%d/%d", &month, &day, &year) == 3)) {
+            value = year * 10000 + month * 100 + day;
+            return true;
+        }
+        return false;
+    }
+
+    static bool parseNumber(const string& text, double& value) {
+        char* end = nullptr;
+        value = strtod(text.c_str(), &end);
+        return !text.empty() && *end == '\0';
+    }
+
+    // [low, high] for "op value" on a numeric column
+    static void rangeFor(const string& op, double value, Predicate& p) {
+        const double inf = numeric_limits<double>::infinity();
+        p.low = -inf;
+        p.high = inf;
+        if (op == "=" || op == "!=") { p.low = p.high = value; p.negate = op == "!="; }
+        else if (op == "<") p.high = nextafter(value, -inf);
+        else if (op == "<=") p.high = value;
+        else if (op == ">") p.low = nextafter(value, inf);
+        else p.low = value;
+    }
+
+    bool parsePredicate(const vector<Token>& tokens, size_t& pos, string& error) {
+        if (tokens[pos].kind != Token::Word) {
+            error = "expected a column name after where/and";
+            return false;
+        }
+        string name = tokens[pos++].text;
+        const string& op = tokens[pos].text;
+        if (tokens[pos].kind != Token::Symbol ||
+            (op != "=" && op != "!=" && op != "<" && op != "<=" && op != ">" && op != ">=")) {
+            error = "expected a comparison after " + name;
+            return false;
+        }
+        pos++;
+
+        // the value: a quoted string, or words up to the next keyword
+        string value;
+        if (tokens[pos].kind == Token::Text) {
+            value = tokens[pos++].text;
+        } else {
+            while (tokens[pos].kind == Token::Word && !isKeyword(tokens[pos], "and") &&
+                   !isKeyword(tokens[pos], "group")) {
+                value += (value.empty() ? "" : " ") + tokens[pos++].text;
+            }
+        }
+        if (value.empty()) {
+            error = "missing value for " + name;
+            return false;
+        }
+
+        Predicate p;
+        p.label = name + " " + op + " " + value;
+        Dimension dim;
+        Column column;
+        if (parseDimension(name, dim)) {
+            if (op != "=" && op != "!=") {
+                error = name + " only supports = and !=";
+                return false;
+            }
+            const Dictionary& dictionary = table->dictionary(dim);
+            p.isDimension = true;
+            p.dim = dim;
+            p.negate = op == "!=";
+            p.code = dictionary.find(value);
+            p.codes.assign(dictionary.size(), p.negate);
+            if (p.code >= 0) p.codes[p.code] = !p.negate;
+        } else if (lower(name) == "year") {
+            double year;
+            if (!parseNumber(value, year)) {
+                error = "year needs a number";
+                return false;
+            }
+            // a year is the range of its dates YYYY0101..YYYY1231
+            p.isDimension = false;
+            p.column = Column::OrderDate;
+            rangeFor(op, year, p); // open ends and != handling
+            if (op == "=" || op == "!=") { p.low = year * 10000; p.high = year * 10000 + 1231; }
+            else if (op == "<") p.high = year * 10000 - 1;
+            else if (op == "<=") p.high = year * 10000 + 1231;
+            else if (op == ">") p.low = year * 10000 + 1231 + 1;
+            else p.low = year * 10000;
+        } else if (lower(name) == "date" || lower(name) == "orderdate") {
+            double date;
+            if (!parseDateValue(value, date)) {
+                error = "date needs YYYY-MM-DD or M/D/YYYY";
+                return false;
+            }
+            p.isDimension = false;
+            p.column = Column::OrderDate;
+            rangeFor(op, date, p);
+        } else if (parseColumn(name, column)) {
+            double number;
+            if (!parseNumber(value, number)) {
+                error = name + " needs a number";
+                return false;
+            }
+            p.isDimension = false;
+            p.column = column;
+            rangeFor(op, number, p);
+        } else {
+            error = "unknown column: " + name;
+            return false;
+        }
+        predicates.push_back(p);
+        return true;
+    }
+
+    bool parse(const string& text, string& error) {
+        vector<Token> tokens = tokenize(text);
+        size_t pos = 0;
+
+        // aggregate list
+        do {
+            if (tokens[pos].kind == Token::Symbol && tokens[pos].text == ",") pos++;
+            if (tokens[pos].kind != Token::Word) {
+                error = "expected an aggregate like sum(totalProfit)";
+                return false;
+            }
+            string function = lower(tokens[pos].text);
+            AggregateSpec spec;
+            if (function == "sum") spec.function = Aggregate::Sum;
+            else if (function == "avg") spec.function = Aggregate::Avg;
+            else if (function == "min") spec.function = Aggregate::Min;
+            else if (function == "max") spec.function = Aggregate::Max;
+            else if (function == "count") spec.function = Aggregate::Count;
+            else {
+                error = "unknown aggregate: " + tokens[pos].text;
+                return false;
+            }
+            pos++;
+            if (tokens[pos].text != "(") {
+                error = "expected ( after " + function;
+                return false;
+            }
+            pos++;
+            string field = tokens[pos].text;
+            if (spec.function == Aggregate::Count && field == "*") {
+                spec.column = Column::Profit;
+            } else if (!parseColumn(field, spec.column)) {
+                error = "unknown numeric column: " + field;
+                return false;
+            }
+            pos++;
+            if (tokens[pos].text != ")") {
+                error = "expected ) after " + field;
+                return false;
+            }
+            pos++;
+            spec.label = function + "(" + field + ")";
+            aggregates.push_back(spec);
+        } while (tokens[pos].kind == Token::Symbol && tokens[pos].text == ",");
+
+        if (isKeyword(tokens[pos], "where")) {
+            pos++;
+            if (!parsePredicate(tokens, pos, error)) return false;
+            while (isKeyword(tokens[pos], "and")) {
+                pos++;
+                if (!parsePredicate(tokens, pos, error)) return false;
+            }
+        }
+
+        if (isKeyword(tokens[pos], "group")) {
+            pos++;
+            if (!isKeyword(tokens[pos], "by") || !parseDimension(tokens[pos + 1].text, groupBy)) {
+                error = "expected group by region, country, item, channel or priority";
+                return false;
+            }
+            grouped = true;
+            pos += 2;
+        }
+        if (tokens[pos].kind != Token::End) {
+            error = "unexpected: " + tokens[pos].text;
+            return false;
+        }
+        return true;
+    }
+
+    // ---- planning ----
+
+    template <typename T>
+    static bool inRange(T value, const Predicate& p) {
+        bool in = value >= p.low && value <= p.high;
+        return in != p.negate;
+    }
+
+    // fraction of rows passing a numeric predicate, from an even sample
+    double sampleSelectivity(const Predicate& p) const {
+        size_t n = table->size();
+        size_t step = max<size_t>(1, n / 4096);
+        size_t sampled = 0, passed = 0;
+        for (size_t row = 0; row < n; row += step) {
+            sampled++;
+            if (p.column == Column::Units || p.column == Column::OrderDate) {
+                if (inRange(intColumn(p.column)[row], p)) passed++;
+            } else if (inRange(doubleColumn(p.column)[row], p)) {
+                passed++;
+            }
+        }
+        return sampled == 0 ? 0 : static_cast<double>(passed) / sampled;
+    }
+
+    void plan() {
+        double n = max<size_t>(table->size(), 1);
+        for (auto& p : predicates) {
+            if (p.isDimension) {
+                // exact, from the posting list lengths
+                const InvertedIndex& index = indexes->index(p.dim);
+                double matching = p.code >= 0 ? index.postings(static_cast<uint16_t>(p.code)).size() : 0;
+                p.selectivity = p.negate ? 1 - matching / n : matching / n;
+            } else {
+                p.selectivity = sampleSelectivity(p);
+            }
+        }
+        stable_sort(predicates.begin(), predicates.end(),
+                    [](const Predicate& a, const Predicate& b) { return a.selectivity < b.selectivity; });
+    }
+
+    // ---- execution ----
+
+    const vector<double>& doubleColumn(Column column) const {
+        switch (column) {
+            case Column::Revenue: return table->totalRevenue;
+            case Column::Cost: return table->totalCost;
+            default: return table->totalProfit;
+        }
+    }
+
+    const vector<int>& intColumn(Column column) const {
+        return column == Column::Units ? table->unitsSold : table->orderDate;
+    }
+
+    // keep the selected rows that pass p
+    template <typename T>
+    static void filterRange(const vector<T>& column, const Predicate& p, vector<uint32_t>& selection) {
+        size_t kept = 0;
+        for (uint32_t row : selection) {
+            selection[kept] = row;
+            kept += inRange(column[row], p);
+        }
+        selection.resize(kept);
+    }
+
+    void filter(const Predicate& p, vector<uint32_t>& selection) const {
+        if (p.isDimension) {
+            const vector<uint16_t>& codes = table->codes(p.dim);
+            size_t kept = 0;
+            for (uint32_t row : selection) {
+                selection[kept] = row;
+                kept += p.codes[codes[row]];
+            }
+            selection.resize(kept);
+        } else if (p.column == Column::Units || p.column == Column::OrderDate) {
+            filterRange(intColumn(p.column), p, selection);
+        } else {
+            filterRange(doubleColumn(p.column), p, selection);
+        }
+    }
+
+    // record IDs passing every predicate, most selective first
+    vector<uint32_t> select() const {
+        vector<uint32_t> selection;
+        size_t first = 0;
+        if (!predicates.empty() && predicates[0].isDimension && !predicates[0].negate) {
+            // start from the posting list of the most selective equality
+            const Predicate& p = predicates[0];
+            if (p.code < 0) return selection;
+            PostingList list = indexes->index(p.dim).postings(static_cast<uint16_t>(p.code));
+            selection.assign(list.first, list.last);
+            first = 1;
+        } else {
+            selection.resize(table->size());
+            for (uint32_t row = 0; row < selection.size(); ++row) selection[row] = row;
+        }
+        for (size_t i = first; i < predicates.size() && !selection.empty(); ++i) {
+            filter(predicates[i], selection);
+        }
+        return selection;
+    }
+
+public:
+    // Parse and plan the text after "query"; false with a message on error
+    bool compile(const string& text, const SalesTable& salesTable, const SecondaryIndexes& salesIndexes,
+                 string& error) {
+        table = &salesTable;
+        indexes = &salesIndexes;
+        aggregates.clear();
+        predicates.clear();
+        grouped = false;
+        if (!parse(text, error)) return false;
+        plan();
+        return true;
+    }
+
+    void printPlan(ostream& os = cout) const {
+        os << "\n--- Query Plan ---\n";
+        os << fixed << setprecision(1);
+        for (size_t i = 0; i < predicates.size(); ++i) {
+            const Predicate& p = predicates[i];
+            os << "  " << (i + 1) << ". " << p.label << "  (~" << 100 * p.selectivity << "% of rows"
+                 << (i == 0 && p.isDimension && !p.negate ? ", from index" : "") << ")\n";
+        }
+        if (predicates.empty()) os << "  full scan\n";
+        if (grouped) os << "  group by " << dimensionName(groupBy) << "\n";
+    }
+
+    // Run the plan and print one row per group to os. In CSV or JSON the
+    // rows start a result on out and the caller adds any summaries and ends it.
+    size_t execute(ResultWriter& out, ostream& os = cout) const {
+        vector<uint32_t> selection = select();
+
+        size_t numGroups = grouped ? table->dictionary(groupBy).size() : 1;
+        const uint16_t* groupCodes = grouped ? table->codes(groupBy).data() : nullptr;
+        vector<size_t> counts(numGroups, 0);
+        for (uint32_t row : selection) counts[groupCodes ? groupCodes[row] : 0]++;
+
+        // one accumulator array per aggregate, filled column by column
+        vector<vector<double>> results;
+        for (const auto& spec : aggregates) {
+            double init = spec.function == Aggregate::Min ? numeric_limits<double>::infinity()
+                        : spec.function == Aggregate::Max ? -numeric_limits<double>::infinity() : 0;
+            vector<double> acc(numGroups, init);
+            if (spec.function != Aggregate::Count) {
+                bool isInt = spec.column == Column::Units;
+                const vector<double>& doubles = doubleColumn(spec.column);
+                const vector<int>& ints = intColumn(Column::Units);
+                for (uint32_t row : selection) {
+                    double v = isInt ? ints[row] : doubles[row];
+                    double& a = acc[groupCodes ? groupCodes[row] : 0];
+                    if (spec.function == Aggregate::Min) a = min(a, v);
+                    else if (spec.function == Aggregate::Max) a = max(a, v);
+                    else a += v;
+                }
+            }
+            for (size_t g = 0; g < numGroups; ++g) {
+                if (spec.function == Aggregate::Count) acc[g] = counts[g];
+                else if (spec.function == Aggregate::Avg) acc[g] = counts[g] ? acc[g] / counts[g] : 0;
+            }
+            results.push_back(acc);
+        }
+
+        // groups alphabetically
+        vector<size_t> order;
+        for (size_t g = 0; g < numGroups; ++g) {
+            if (counts[g] > 0 || !grouped) order.push_back(g);
+        }
+        if (grouped) {
+            const Dictionary& dictionary = table->dictionary(groupBy);
+            sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return dictionary.decode(static_cast<uint16_t>(a)) < dictionary.decode(static_cast<uint16_t>(b));
+            });
+        }
+
+        if (out.format() != OutputFormat::Plain) {
+            vector<ResultWriter::Column> columns;
+            if (grouped) columns.push_back({dimensionKey(groupBy), ""});
+            for (const auto& spec : aggregates) columns.push_back({spec.label.c_str(), ""});
+            out.begin("Query Result", columns);
+            for (size_t g : order) {
+                if (grouped) out.text(table->dictionary(groupBy).decode(static_cast<uint16_t>(g)));
+                for (size_t a = 0; a < aggregates.size(); ++a) {
+                    if (aggregates[a].function == Aggregate::Count) out.integer(static_cast<long long>(results[a][g]));
+                    else if (counts[g] == 0) out.missing();
+                    else out.money(results[a][g]);
+                }
+                out.endRow();
+            }
+            return selection.size();
+        }
+
+        os << "\n--- Query Result ---\n";
+        if (grouped) os << left << setw(36) << dimensionName(groupBy) << right;
+        for (const auto& spec : aggregates) os << setw(22) << spec.label;
+        os << "\n" << fixed << setprecision(2);
+        for (size_t g : order) {
+            if (grouped) os << left << setw(36) << table->dictionary(groupBy).decode(static_cast<uint16_t>(g)) << right;
+            for (size_t a = 0; a < aggregates.size(); ++a) {
+                if (aggregates[a].function == Aggregate::Count) os << setw(22) << static_cast<size_t>(results[a][g]);
+                else if (counts[g] == 0) os << setw(22) << "-";
+                else os << setw(22) << results[a][g];
+            }
+            os << "\n";
+        }
+        return selection.size();
+    }
+};
+
+#endif // QUERY_H
@@ -0,0 +1,76 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+// Rendered output of earlier commands keyed by the normalized command text.
+// Every entry remembers the dataset version it was computed against; a
+// load or any other change to the data bumps the version and empties the cache.
+class QueryCache {
+private:
+    struct Entry {
+        string output;
+        long long computeNs; // how long the command originally took
+    };
+
+    unordered_map<string, Entry> entries;
+    uint64_t version = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t invalidations = 0;
+    long long savedNs = 0;
+
+public:
+    // Cached output for a command, nullptr on a miss
+    const string* find(const string& key, uint64_t datasetVersion) {
+        if (datasetVersion != version) {
+            if (!entries.empty()) invalidations++;
+            entries.clear();
+            version = datasetVersion;
+        }
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        return &it->second.output;
+    }
+
+    void store(const string& key, const string& output, long long computeNs) {
+        entries[key] = {output, computeNs};
+    }
+
+    // account for a hit that took serveNs instead of the original run time
+    void recordSaving(const string& key, long long serveNs) {
+        auto it = entries.find(key);
+        if (it != entries.end()) savedNs += it->second.computeNs - serveNs;
+    }
+
+    void printStats() const {
+        size_t bytes = 0;
+        for (const auto& entry : entries) bytes += entry.first.size() + entry.second.output.size();
+        size_t lookups = hits + misses;
+
+        cout << "\n--- Query Cache ---\n";
+        cout << "Dataset version:    " << version << "\n";
+        cout << "Entries:            " << entries.size() << " (" << bytes << " bytes)\n";
+        cout << "Hits:               " << hits << "\n";
+        cout << "Misses:             " << misses << "\n";
+        cout << fixed << setprecision(2);
+        cout << "Hit rate:           " << (lookups ? 100.0 * hits / lookups : 0) << "%\n";
+        cout << "Invalidations:      " << invalidations << "\n";
+        cout << "Time saved (ns):    " << savedNs << "\n";
+        for (const auto& entry : entries) {
+            cout << "  " << entry.first << "  (computed in " << entry.second.computeNs << " ns)\n";
+        }
+    }
+};
+
+#endif // QUERY_CACHE_H
@@ -0,0 +1,405 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+
+using namespace std;
+
+// Addresses are either a Unix socket path or "tcp:<port>" on 127.0.0.1.
+// Both return a socket, -1 on failure with the reason in error.
+inline int listenOn(const string& address, string& error) {
+    int fd;
+    if (address.rfind("tcp:", 0) == 0) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(atoi(address.c_str() + 4)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error = strerror(errno);
+            close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_un addr{};
+        if (address.size() >= sizeof(addr.sun_path)) {
+            error = "socket path too long";
+            return -1;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, address.c_str());
+        unlink(address.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error = strerror(errno);
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        error = strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline int connectTo(const string& address, string& error) {
+    int fd;
+    int result;
+    if (address.rfind("tcp:", 0) == 0) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(atoi(address.c_str() + 4)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    } else {
+        sockaddr_un addr{};
+        if (address.size() >= sizeof(addr.sun_path)) {
+            error = "socket path too long";
+            return -1;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, address.c_str());
+        result = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    }
+    if (result < 0) {
+        error = strerror(errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Line-oriented query server. One epoll loop accepts clients, reads their
+// command lines and writes responses; a pool of worker threads runs the
+// commands so a slow one never stalls the other connections. Every
+// connection has at most one command in flight, so its responses come back
+// in the order it sent the commands. The handler returns the whole response,
+// framed the way batch mode frames it (ending with a "." line).
+// SIGINT or SIGTERM stops the server.
+class QueryServer {
+public:
+    typedef function<string(const string&)> Handler;
+
+private:
+    struct Connection {
+        int fd;
+        string input;
+        string output;
+        size_t written = 0;
+        bool busy = false;     // a command is with the workers
+        bool closing = false;  // peer hung up or sent "quit"
+        uint32_t events = EPOLLIN | EPOLLRDHUP;
+    };
+
+    struct Job {
+        uint64_t connection;
+        string command;
+    };
+
+    // longest command line, and most unread input kept per connection
+    static const size_t MAX_LINE_BYTES = 64 << 10;
+    static const size_t MAX_INPUT_BYTES = 16 << 20;
+
+    Handler handler;
+    size_t numWorkers;
+    int epollFd = -1;
+    int listenFd = -1;
+    int wakeFd = -1;
+    int signalFd = -1;
+
+    unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnection = 1;
+
+    // commands waiting for a worker
+    mutex jobMutex;
+    condition_variable jobReady;
+    deque<Job> jobs;
+    bool stopping = false;
+
+    // finished commands waiting for the event loop
+    mutex doneMutex;
+    vector<pair<uint64_t, string>> done;
+
+    size_t requestsServed = 0;
+    size_t connectionsAccepted = 0;
+
+    static void setNonBlocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    void watch(int fd, uint32_t events, uint64_t tag) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = tag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void workerLoop() {
+        while (true) {
+            Job job;
+            {
+                unique_lock<mutex> lock(jobMutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            string response = handler(job.command);
+            {
+                lock_guard<mutex> lock(doneMutex);
+                done.emplace_back(job.connection, move(response));
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    void closeConnection(uint64_t id) {
+        Connection& conn = connections[id];
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        connections.erase(id);
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) return;
+            setNonBlocking(fd);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            uint64_t id = nextConnection++;
+            connections[id].fd = fd;
+            // tags of client connections start above the fixed descriptors
+            watch(fd, EPOLLIN | EPOLLRDHUP, id + 3);
+            connectionsAccepted++;
+        }
+    }
+
+    // Write what is buffered; false if the connection was closed
+    bool flushOutput(uint64_t id) {
+        Connection& conn = connections[id];
+        while (conn.written < conn.output.size()) {
+            ssize_t n = write(conn.fd, conn.output.data() + conn.written, conn.output.size() - conn.written);
+            if (n > 0) {
+                conn.written += n;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                closeConnection(id);
+                return false;
+            }
+        }
+        if (conn.written == conn.output.size()) {
+            conn.output.clear();
+            conn.written = 0;
+        }
+        // stop reading once the client is done, wait for writability only
+        // while output is pending
+        uint32_t events = (conn.closing ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)) |
+                          (conn.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+        if (events != conn.events) {
+            epoll_event event{};
+            event.events = events;
+            event.data.u64 = id + 3;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event);
+            conn.events = events;
+        }
+        if (conn.closing && !conn.busy && conn.output.empty()) {
+            closeConnection(id);
+            return false;
+        }
+        return true;
+    }
+
+    // Hand the connection's next complete line to the workers
+    void dispatchNext(uint64_t id) {
+        Connection& conn = connections[id];
+        while (!conn.busy) {
+            size_t newline = conn.input.find('\n');
+            if (newline == string::npos) return;
+            string command = conn.input.substr(0, newline);
+            conn.input.erase(0, newline + 1);
+            while (!command.empty() && isspace(static_cast<unsigned char>(command.back()))) command.pop_back();
+            size_t first = command.find_first_not_of(" \t");
+            if (first == string::npos || command[first] == '#') continue;
+            command = command.substr(first);
+            if (command == "quit" || command == "exit") {
+                conn.closing = true;
+                return;
+            }
+            conn.busy = true;
+            {
+                lock_guard<mutex> lock(jobMutex);
+                jobs.push_back({id, move(command)});
+            }
+            jobReady.notify_one();
+        }
+    }
+
+    void readClient(uint64_t id) {
+        Connection& conn = connections[id];
+        char chunk[4096];
+        while (true) {
+            ssize_t n = read(conn.fd, chunk, sizeof(chunk));
+            if (n > 0) {
+                conn.input.append(chunk, n);
+                if (inputTooLong(conn.input)) {
+                    // drop what is buffered; a command in flight still
+                    // gets its response before the connection closes
+                    conn.input.clear();
+                    conn.closing = true;
+                    if (!conn.busy) conn.output += "Line too long, closing the connection\n.\n";
+                    break;
+                }
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                conn.closing = true;
+                break;
+            }
+        }
+        dispatchNext(id);
+        if (connections.count(id)) flushOutput(id);
+    }
+
+    // A client that sends a line without end, or queues more commands than
+    // the server will hold while one runs, is cut off
+    static bool inputTooLong(const string& input) {
+        if (input.size() > MAX_INPUT_BYTES) return true;
+        size_t lastNewline = input.rfind('\n');
+        size_t tail = lastNewline == string::npos ? input.size() : input.size() - lastNewline - 1;
+        return tail > MAX_LINE_BYTES;
+    }
+
+    void deliverResponses() {
+        uint64_t count;
+        ssize_t ignored = read(wakeFd, &count, sizeof(count));
+        (void)ignored;
+        vector<pair<uint64_t, string>> finished;
+        {
+            lock_guard<mutex> lock(doneMutex);
+            finished.swap(done);
+        }
+        for (auto& response : finished) {
+            requestsServed++;
+            auto it = connections.find(response.first);
+            if (it == connections.end()) continue;
+            it->second.busy = false;
+            it->second.output += response.second;
+            dispatchNext(response.first);
+            flushOutput(response.first);
+        }
+    }
+
+public:
+    QueryServer(Handler handler, size_t numWorkers)
+        : handler(move(handler)), numWorkers(max<size_t>(numWorkers, 1)) {}
+
+    // Serve until SIGINT or SIGTERM; false if the socket could not be opened
+    bool run(const string& address) {
+        string error;
+        listenFd = listenOn(address, error);
+        if (listenFd < 0) {
+            cerr << "Could not listen on " << address << ": " << error << endl;
+            return false;
+        }
+        setNonBlocking(listenFd);
+
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK);
+        wakeFd = eventfd(0, EFD_NONBLOCK);
+
+        epollFd = epoll_create1(0);
+        watch(listenFd, EPOLLIN, 0);
+        watch(wakeFd, EPOLLIN, 1);
+        watch(signalFd, EPOLLIN, 2);
+
+        // started after the signal mask so the workers inherit it
+        vector<thread> workers;
+        for (size_t i = 0; i < numWorkers; ++i) {
+            workers.emplace_back(&QueryServer::workerLoop, this);
+        }
+        cerr << "Serving on " << address << " with " << numWorkers << " workers (Ctrl+C to stop)" << endl;
+
+        bool running = true;
+        epoll_event events[64];
+        while (running) {
+            int ready = epoll_wait(epollFd, events, 64, -1);
+            if (ready < 0 && errno == EINTR) continue;
+            for (int i = 0; i < ready; ++i) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == 0) {
+                    acceptClients();
+                } else if (tag == 1) {
+                    deliverResponses();
+                } else if (tag == 2) {
+                    running = false;
+                } else {
+                    uint64_t id = tag - 3;
+                    if (!connections.count(id)) continue;
+                    if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                        // gone in both directions, nobody left to answer
+                        closeConnection(id);
+                    } else if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+                        readClient(id);
+                    } else if (events[i].events & EPOLLOUT) {
+                        flushOutput(id);
+                    }
+                }
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (auto& worker : workers) worker.join();
+        while (!connections.empty()) closeConnection(connections.begin()->first);
+        close(listenFd);
+        close(wakeFd);
+        close(signalFd);
+        close(epollFd);
+        if (address.rfind("tcp:", 0) != 0) unlink(address.c_str());
+        cerr << "Served " << requestsServed << " requests on " << connectionsAccepted << " connections" << endl;
+        return true;
+    }
+};
+
+#endif // QUERY_SERVER_H
@@ -0,0 +1,113 @@
+#ifndef READ_BENCHMARK_H
+#define READ_BENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "FileBlockReader.h"
+#include "LoadPipeline.h"
+#include "PoolBenchmark.h"
+
+using namespace std;
+
+// Source reading the files one after the other through ifstream, the way
+// "load" reads a single file
+inline LoadPipeline::Source ifstreamSource(const vector<string>& files) {
+    auto current = make_shared<ifstream>();
+    auto next = make_shared<size_t>(0);
+    auto inner = make_shared<LoadPipeline::Source>();
+    return [&files, current, next, inner](LoadPipeline::Block& block) {
+        while (true) {
+            if (*inner && (*inner)(block)) {
+                block.file = &files[*next - 1];
+                return true;
+            }
+            if (*next == files.size()) return false;
+            current->close();
+            current->clear();
+            current->open(files[(*next)++], ios::binary);
+            *inner = LoadPipeline::streamSource(*current);
+        }
+    };
+}
+
+// Read throughput over a directory of CSV files for the ifstream path and
+// FileBlockReader with pread and with io_uring: reading alone, and feeding
+// the load pipeline up to parsed records (not inserted anywhere)
+inline void runReadBenchmark(const vector<string>& files) {
+    size_t totalBytes = 0;
+    {
+        FileBlockReader probe(files);
+        totalBytes = probe.totalBytes();
+        if (string(probe.backend()) != "io_uring") {
+            cout << "io_uring is not available here, so both FileBlockReader rows use pread.\n";
+        }
+    }
+    double mb = totalBytes / 1e6;
+    cout << "\n--- File Read Benchmark ---\n";
+    cout << "Files: " << files.size() << ", bytes: " << totalBytes << "\n";
+
+    // one untimed pass, so every backend reads from the page cache
+    vector<char> buffer(1 << 20);
+    auto readAllIfstream = [&] {
+        size_t bytes = 0;
+        for (const string& path : files) {
+            ifstream in(path, ios::binary);
+            while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) bytes += in.gcount();
+        }
+        return bytes;
+    };
+    readAllIfstream();
+
+    cout << left << setw(12) << "Backend" << right << setw(16) << "read MB/s" << setw(20) << "read+parse MB/s"
+         << setw(16) << "parsed rows" << "\n";
+    cout << fixed << setprecision(1);
+    for (int backend = 0; backend < 3; ++backend) {
+        const char* name = backend == 0 ? "ifstream" : backend == 1 ? "pread" : "io_uring";
+        volatile size_t sink = 0;
+        double readNs;
+        if (backend == 0) {
+            readNs = timeNs([&] { sink = readAllIfstream(); });
+        } else {
+            readNs = timeNs([&] {
+                FileBlockReader reader(files, FileBlockReader::DEFAULT_BLOCK_SIZE,
+                                       FileBlockReader::DEFAULT_QUEUE_DEPTH, backend == 2);
+                FileBlockReader::Block block;
+                size_t bytes = 0;
+                while (reader.next(block)) bytes += block.data.size();
+                sink = bytes;
+            });
+        }
+
+        atomic<size_t> bytesRead{0};
+        atomic<bool> cancel{false};
+        size_t rows = 0;
+        ostringstream errors;
+        LoadPipeline pipeline;
+        auto countRows = [&rows](vector<SalesData>& batch) {
+            rows += batch.size();
+            batch.clear();
+        };
+        double parseNs = timeNs([&] {
+            if (backend == 0) {
+                pipeline.run(ifstreamSource(files), countRows, errors, bytesRead, cancel);
+            } else {
+                FileBlockReader reader(files, FileBlockReader::DEFAULT_BLOCK_SIZE,
+                                       FileBlockReader::DEFAULT_QUEUE_DEPTH, backend == 2);
+                pipeline.run(reader.source(), countRows, errors, bytesRead, cancel);
+            }
+        });
+
+        cout << left << setw(12) << name << right << setw(16) << mb / (readNs / 1e9)
+             << setw(20) << mb / (parseNs / 1e9) << setw(16) << rows << "\n";
+    }
+    cout << "All passes read from the page cache, so the numbers show the cost of the read\n"
+         << "calls and copies rather than of the disk.\n";
+}
+
+#endif // READ_BENCHMARK_H
@@ -0,0 +1,93 @@
+#ifndef RESERVOIR_SAMPLE_H
+#define RESERVOIR_SAMPLE_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <unordered_map>
+#include "SalesData.h"
+
+using namespace std;
+
+// Uniform random sample of fixed size over every record ever added
+// (Algorithm R): record i replaces a random slot with probability size/i.
+class ReservoirSample {
+private:
+    vector<SalesData> sample;
+    size_t capacity;
+    size_t seen = 0;
+    mt19937_64 rng;
+
+public:
+    explicit ReservoirSample(size_t capacity = 10000) : capacity(capacity), rng(12345) {
+        sample.reserve(capacity);
+    }
+
+    void add(const SalesData& record) {
+        seen++;
+        if (sample.size() < capacity) {
+            sample.push_back(record);
+            return;
+        }
+        uniform_int_distribution<size_t> slot(0, seen - 1);
+        size_t j = slot(rng);
+        if (j < capacity) sample[j] = record;
+    }
+
+    const vector<SalesData>& get() const {
+        return sample;
+    }
+
+    // number of records the sample was drawn from
+    size_t population() const {
+        return seen;
+    }
+};
+
+// Estimated profit total of one group with a 95% confidence half-width
+struct GroupEstimate {
+    string group;
+    double total;
+    double halfWidth;
+};
+
+// Estimate every group's profit total from a uniform sample without
+// replacement of size n out of population N. Per group the estimator is
+// N * mean(profit if in group else 0); its standard error is
+// N * s / sqrt(n) * sqrt(1 - n/N), with the finite population correction.
+inline vector<GroupEstimate> estimateGroupTotals(const vector<const SalesData*>& sample, size_t population,
+                                                 string SalesData::* field) {
+    vector<GroupEstimate> estimates;
+    if (sample.empty()) return estimates;
+    unordered_map<string, size_t> slots;
+    vector<double> sums, sumSquares;
+    for (const SalesData* item : sample) {
+        const SalesData& record = *item;
+        auto it = slots.find(record.*field);
+        if (it == slots.end()) {
+            it = slots.emplace(record.*field, sums.size()).first;
+            sums.push_back(0);
+            sumSquares.push_back(0);
+        }
+        sums[it->second] += record.totalProfit;
+        sumSquares[it->second] += record.totalProfit * record.totalProfit;
+    }
+
+    double n = static_cast<double>(sample.size());
+    double N = static_cast<double>(population);
+    double correction = N > 1 ? sqrt(max(0.0, (N - n) / (N - 1))) : 0;
+    estimates.resize(sums.size());
+    for (const auto& slot : slots) {
+        size_t g = slot.second;
+        double mean = sums[g] / n;
+        // rows outside the group count as 0
+        double variance = n > 1 ? (sumSquares[g] - n * mean * mean) / (n - 1) : 0;
+        estimates[g].group = slot.first;
+        estimates[g].total = N * mean;
+        estimates[g].halfWidth = 1.96 * N * sqrt(max(0.0, variance) / n) * correction;
+    }
+    return estimates;
+}
+
+#endif // RESERVOIR_SAMPLE_H
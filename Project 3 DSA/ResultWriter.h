@@ -0,0 +1,315 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <charconv>
+
+using namespace std;
+
+enum class OutputFormat { Plain, Csv, Json };
+
+inline bool parseOutputFormat(const string& name, OutputFormat& format) {
+    if (name == "plain") format = OutputFormat::Plain;
+    else if (name == "csv") format = OutputFormat::Csv;
+    else if (name == "json") format = OutputFormat::Json;
+    else return false;
+    return true;
+}
+
+inline const char* outputFormatName(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::Csv: return "csv";
+        case OutputFormat::Json: return "json";
+        default: return "plain";
+    }
+}
+
+inline void appendInteger(string& out, long long value) {
+    char digits[24];
+    auto result = to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr - digits);
+}
+
+// Append value with exactly two decimals, like fixed << setprecision(2).
+// Amounts below 1e10 are rounded to whole cents and written as integers.
+// The product value * 100 is off from the exact one by less than 1e-4
+// there, so it rounds the same way unless it lies within 1e-3 of a half
+// cent; those ties and anything larger go through snprintf, which rounds
+// the exact binary value.
+inline void appendFixed2(string& out, double value) {
+    double scaled = fabs(value) * 100;
+    double fraction = scaled - floor(scaled);
+    if (!(fabs(value) < 1e10) || fabs(fraction - 0.5) < 1e-3) {
+        char text[512];
+        int len = snprintf(text, sizeof(text), "%.2f", value);
+        out.append(text, len);
+        return;
+    }
+    long long cents = llround(scaled);
+    // snprintf keeps the sign of -0.0 and of negatives that round to zero
+    if (signbit(value)) out += '-';
+    appendInteger(out, cents / 100);
+    out += '.';
+    out += static_cast<char>('0' + cents % 100 / 10);
+    out += static_cast<char>('0' + cents % 10);
+}
+
+// Renders a result table as plain text, CSV or JSON into one buffer that is
+// reused across commands and handed to cout (or another stream) in a single
+// write at the end.
+//
+// Plain text keeps the CLI's usual layout: every column has a prefix that is
+// written in front of its value (": $", " / ", ...), sections print as
+// "name:" headings and summaries as "Label value" lines. CSV has a header
+// row and the table rows only. JSON is one object per result:
+// {"title": ..., "rows": [{column: value, ...}], summary keys...}.
+class ResultWriter {
+public:
+    struct Column {
+        const char* name;        // CSV header and JSON key
+        const char* plainPrefix; // written before the value in plain text
+    };
+
+private:
+    OutputFormat outputFormat = OutputFormat::Plain;
+    ostream* output = &cout;
+    string buffer;
+    vector<Column> columns;
+    vector<string> sectionNames;
+    string currentSection;
+    size_t column = 0;
+    size_t rows = 0;
+    bool rowsClosed = false;
+
+    void appendCsvField(const string& value) {
+        if (value.find_first_of(",\"\n\r") == string::npos) {
+            buffer += value;
+            return;
+        }
+        buffer += '"';
+        for (char c : value) {
+            if (c == '"') buffer += '"';
+            buffer += c;
+        }
+        buffer += '"';
+    }
+
+    void appendJsonString(const string& value) {
+        buffer += '"';
+        for (char c : value) {
+            switch (c) {
+                case '"': buffer += "\\\""; break;
+                case '\\': buffer += "\\\\"; break;
+                case '\n': buffer += "\\n"; break;
+                case '\r': buffer += "\\r"; break;
+                case '\t': buffer += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        buffer += escaped;
+                    } else {
+                        buffer += c;
+                    }
+            }
+        }
+        buffer += '"';
+    }
+
+    void appendJsonMoney(double value) {
+        if (isfinite(value)) appendFixed2(buffer, value);
+        else buffer += "null";
+    }
+
+    // separator, section and key in front of the next cell
+    void startCell() {
+        if (outputFormat == OutputFormat::Csv) {
+            if (column == 0 && !sectionNames.empty()) {
+                appendCsvField(currentSection);
+                buffer += ',';
+            } else if (column > 0) {
+                buffer += ',';
+            }
+        } else if (outputFormat == OutputFormat::Json) {
+            if (column == 0) {
+                buffer += rows == 0 ? "\n  {" : ",\n  {";
+                if (!sectionNames.empty()) {
+                    appendJsonString(sectionNames[0]);
+                    buffer += ": ";
+                    appendJsonString(currentSection);
+                    buffer += ", ";
+                }
+            } else {
+                buffer += ", ";
+            }
+            appendJsonString(columns[column].name);
+            buffer += ": ";
+        } else {
+            buffer += columns[column].plainPrefix;
+        }
+    }
+
+    void closeRows() {
+        if (outputFormat == OutputFormat::Json && !rowsClosed) {
+            buffer += rows == 0 ? "]" : "\n]";
+        }
+        rowsClosed = true;
+    }
+
+    void startSummary(const char* key, const char* plainLabel) {
+        if (outputFormat == OutputFormat::Json) {
+            closeRows();
+            buffer += ",\n\"";
+            buffer += key;
+            buffer += "\": ";
+        } else if (outputFormat == OutputFormat::Plain) {
+            buffer += plainLabel;
+        }
+    }
+
+public:
+    void setFormat(OutputFormat format) {
+        outputFormat = format;
+    }
+
+    OutputFormat format() const {
+        return outputFormat;
+    }
+
+    // Where end() writes the result, cout unless told otherwise
+    void setOutput(ostream& out) {
+        output = &out;
+    }
+
+    // Start a result; groupedBy names the column sections are stored under
+    // in CSV and JSON (leave it empty when the result has no sections)
+    void begin(const string& title, const vector<Column>& tableColumns, const char* groupedBy = nullptr) {
+        columns = tableColumns;
+        sectionNames.clear();
+        if (groupedBy != nullptr) sectionNames.push_back(groupedBy);
+        currentSection.clear();
+        column = 0;
+        rows = 0;
+        rowsClosed = false;
+
+        if (outputFormat == OutputFormat::Plain) {
+            buffer += "\n--- ";
+            buffer += title;
+            buffer += " ---\n";
+        } else if (outputFormat == OutputFormat::Csv) {
+            for (size_t c = 0; c < sectionNames.size(); ++c) {
+                buffer += sectionNames[c];
+                buffer += ',';
+            }
+            for (size_t c = 0; c < columns.size(); ++c) {
+                if (c > 0) buffer += ',';
+                buffer += columns[c].name;
+            }
+            buffer += '\n';
+        } else {
+            buffer += "{\"title\": ";
+            appendJsonString(title);
+            buffer += ",\n\"rows\": [";
+        }
+    }
+
+    // Rows that follow belong to this group
+    void section(const string& name) {
+        currentSection = name;
+        if (outputFormat == OutputFormat::Plain) {
+            buffer += name;
+            buffer += ":\n";
+        }
+    }
+
+    void text(const string& value) {
+        startCell();
+        if (outputFormat == OutputFormat::Csv) appendCsvField(value);
+        else if (outputFormat == OutputFormat::Json) appendJsonString(value);
+        else buffer += value;
+        column++;
+    }
+
+    void integer(long long value) {
+        startCell();
+        appendInteger(buffer, value);
+        column++;
+    }
+
+    void money(double value) {
+        startCell();
+        if (outputFormat == OutputFormat::Json) appendJsonMoney(value);
+        else appendFixed2(buffer, value);
+        column++;
+    }
+
+    // A cell with no value: null in JSON, empty in CSV, "-" in plain text
+    void missing() {
+        startCell();
+        if (outputFormat == OutputFormat::Json) buffer += "null";
+        else if (outputFormat == OutputFormat::Plain) buffer += '-';
+        column++;
+    }
+
+    void endRow() {
+        if (outputFormat == OutputFormat::Json) buffer += '}';
+        else buffer += '\n';
+        column = 0;
+        rows++;
+    }
+
+    // Rows left out of a truncated result
+    void more(size_t count) {
+        if (count == 0) return;
+        if (outputFormat == OutputFormat::Plain) {
+            buffer += "... ";
+            appendInteger(buffer, count);
+            buffer += " more\n";
+        } else {
+            summaryInteger("more", "", count);
+        }
+    }
+
+    // Summary lines below the table; CSV output leaves them out
+    void summaryInteger(const char* key, const char* plainLabel, long long value) {
+        if (outputFormat == OutputFormat::Csv) return;
+        startSummary(key, plainLabel);
+        appendInteger(buffer, value);
+        if (outputFormat == OutputFormat::Plain) buffer += '\n';
+    }
+
+    void summaryMoney(const char* key, const char* plainLabel, double value) {
+        if (outputFormat == OutputFormat::Csv) return;
+        startSummary(key, plainLabel);
+        if (outputFormat == OutputFormat::Json) appendJsonMoney(value);
+        else appendFixed2(buffer, value);
+        if (outputFormat == OutputFormat::Plain) buffer += '\n';
+    }
+
+    void summaryText(const char* key, const char* plainLabel, const string& value) {
+        if (outputFormat == OutputFormat::Csv) return;
+        startSummary(key, plainLabel);
+        if (outputFormat == OutputFormat::Json) {
+            appendJsonString(value);
+        } else {
+            buffer += value;
+            buffer += '\n';
+        }
+    }
+
+    // Finish the result and write it out
+    void end() {
+        if (outputFormat == OutputFormat::Json) {
+            closeRows();
+            buffer += "}\n";
+        }
+        output->write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
+#endif // RESULT_WRITER_H
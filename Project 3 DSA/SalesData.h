@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include "ResultWriter.h"
 
 using namespace std;
 // Sales Data Structure to represent each row of the CSV
@@ -27,29 +28,54 @@ struct SalesData {
     double totalProfit;
     bool isEmpty;
 
-    // Method to print detailed sales record
-    void printDetails(const string& orderID = "") const {
-        cout << fixed << setprecision(2);
+    // Method to print detailed sales record, rendered into one string and
+    // written with a single call
+    void printDetails(const string& orderID = "", ostream& os = cout) const {
+        string out;
+        out.reserve(512);
         if (!orderID.empty()) {
-            cout << "Order ID:         " << orderID << "\n";
+            out += "Order ID:         " + orderID + "\n";
         }
-        cout << "\n--- Order Details ---\n";
-        cout << "Region:           " << region << "\n";
-        cout << "Country:          " << country << "\n";
-        cout << "Item Type:        " << itemType << "\n";
-        cout << "Sales Channel:    " << salesChannel << "\n";
-        cout << "Order Priority:   " << orderPriority << "\n";
-        cout << "Order Date:       " << orderDate << "\n";
-        cout << "Ship Date:        " << shipDate << "\n";
-        cout << "Units Sold:       " << unitsSold << "\n";
-        cout << "Unit Price:       $" << unitPrice << "\n";
-        cout << "Unit Cost:        $" << unitCost << "\n";
-        cout << "Total Revenue:    $" << totalRevenue << "\n";
-        cout << "Total Cost:       $" << totalCost << "\n";
-        cout << "Total Profit:     $" << totalProfit << "\n";
+        out += "\n--- Order Details ---\n";
+        out += "Region:           " + region + "\n";
+        out += "Country:          " + country + "\n";
+        out += "Item Type:        " + itemType + "\n";
+        out += "Sales Channel:    " + salesChannel + "\n";
+        out += "Order Priority:   " + orderPriority + "\n";
+        out += "Order Date:       " + orderDate + "\n";
+        out += "Ship Date:        " + shipDate + "\n";
+        out += "Units Sold:       ";
+        appendInteger(out, unitsSold);
+        out += "\nUnit Price:       $";
+        appendFixed2(out, unitPrice);
+        out += "\nUnit Cost:        $";
+        appendFixed2(out, unitCost);
+        out += "\nTotal Revenue:    $";
+        appendFixed2(out, totalRevenue);
+        out += "\nTotal Cost:       $";
+        appendFixed2(out, totalCost);
+        out += "\nTotal Profit:     $";
+        appendFixed2(out, totalProfit);
+        out += '\n';
+        os.write(out.data(), out.size());
     }
 
-    string getID(){
+    // Method to print the record on one tab-separated line, fields in CSV order
+    void printCompact(ostream& os = cout) const {
+        string out;
+        out.reserve(256);
+        out += region + '\t' + country + '\t' + itemType + '\t' + salesChannel + '\t' + orderPriority + '\t'
+               + orderDate + '\t' + orderID + '\t' + shipDate + '\t';
+        appendInteger(out, unitsSold);
+        for (double value : {unitPrice, unitCost, totalRevenue, totalCost, totalProfit}) {
+            out += '\t';
+            appendFixed2(out, value);
+        }
+        out += '\n';
+        os.write(out.data(), out.size());
+    }
+
+    string getID() const {
         return orderID;
     }
 };
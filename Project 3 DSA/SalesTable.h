@@ -0,0 +1,183 @@
+#ifndef SALES_TABLE_H
+#define SALES_TABLE_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include "SalesData.h"
+
+using namespace std;
+
+// The text columns records can be grouped or filtered by
+enum class Dimension { Region, Country, ItemType, SalesChannel, OrderPriority };
+static const int NUM_DIMENSIONS = 5;
+
+// Accepts the short and the field names, e.g. "item" or "itemType"
+inline bool parseDimension(const string& name, Dimension& dim) {
+    if (name == "region") dim = Dimension::Region;
+    else if (name == "country") dim = Dimension::Country;
+    else if (name == "item" || name == "itemType") dim = Dimension::ItemType;
+    else if (name == "channel" || name == "salesChannel") dim = Dimension::SalesChannel;
+    else if (name == "priority" || name == "orderPriority") dim = Dimension::OrderPriority;
+    else return false;
+    return true;
+}
+
+inline const char* dimensionName(Dimension dim) {
+    switch (dim) {
+        case Dimension::Region: return "Region";
+        case Dimension::Country: return "Country";
+        case Dimension::ItemType: return "Item Type";
+        case Dimension::SalesChannel: return "Sales Channel";
+        default: return "Order Priority";
+    }
+}
+
+// Column name of a dimension in CSV and JSON output
+inline const char* dimensionKey(Dimension dim) {
+    switch (dim) {
+        case Dimension::Region: return "region";
+        case Dimension::Country: return "country";
+        case Dimension::ItemType: return "item_type";
+        case Dimension::SalesChannel: return "sales_channel";
+        default: return "order_priority";
+    }
+}
+
+inline const string& dimensionValue(const SalesData& record, Dimension dim) {
+    switch (dim) {
+        case Dimension::Region: return record.region;
+        case Dimension::Country: return record.country;
+        case Dimension::ItemType: return record.itemType;
+        case Dimension::SalesChannel: return record.salesChannel;
+        default: return record.orderPriority;
+    }
+}
+
+// Turns "M/D/YYYY" into YYYYMMDD so dates compare as integers, 0 if malformed
+inline int parseDate(const string& date) {
+    int month = 0, day = 0, year = 0;
+    if (sscanf(date.c_str(), "%d/%d/%d", &month, &day, &year) != 3) return 0;
+    return year * 10000 + month * 100 + day;
+}
+
+// Maps every distinct value of a text column to a dense code 0..size()-1.
+// Codes are 16 bits, so a column holds at most MAX_VALUES distinct values.
+class Dictionary {
+private:
+    vector<string> values;
+    unordered_map<string, uint16_t> codes;
+
+public:
+    static const size_t MAX_VALUES = 1 << 16;
+
+    // throws length_error rather than let a code wrap onto another value
+    uint16_t encode(const string& value) {
+        auto it = codes.find(value);
+        if (it != codes.end()) return it->second;
+        if (values.size() == MAX_VALUES) {
+            throw length_error("more than " + to_string(MAX_VALUES) + " distinct values");
+        }
+        uint16_t code = static_cast<uint16_t>(values.size());
+        values.push_back(value);
+        codes.emplace(value, code);
+        return code;
+    }
+
+    // code of a value, -1 if it never occurs
+    int find(const string& value) const {
+        auto it = codes.find(value);
+        return it == codes.end() ? -1 : it->second;
+    }
+
+    const string& decode(uint16_t code) const {
+        return values[code];
+    }
+
+    size_t size() const {
+        return values.size();
+    }
+
+    void clear() {
+        values.clear();
+        codes.clear();
+    }
+};
+
+// Column-oriented copy of the loaded records, built after a load. Row i is
+// record ID i: text columns are stored as dictionary codes and the numbers
+// the aggregations need as plain arrays, so scans read only what they use.
+// rows[i] points back at the full record stored in the hash map.
+class SalesTable {
+private:
+    Dictionary dictionaries[NUM_DIMENSIONS];
+    vector<uint16_t> codeColumns[NUM_DIMENSIONS];
+
+public:
+    vector<const SalesData*> rows;
+    vector<double> totalProfit;
+    vector<double> totalRevenue;
+    vector<double> totalCost;
+    vector<int> unitsSold;
+    vector<int> orderDate; // YYYYMMDD
+
+    // (Re)build from the hash map buckets; the buckets must not change while
+    // the table is in use since rows point into them
+    void build(const vector<vector<SalesData>>& buckets) {
+        clear();
+        append(buckets);
+    }
+
+    // Add the records of more buckets, e.g. of the next shard. Throws
+    // length_error naming the column when one has too many distinct values.
+    void append(const vector<vector<SalesData>>& buckets) {
+        for (const auto& bucket : buckets) {
+            for (const auto& record : bucket) {
+                for (int d = 0; d < NUM_DIMENSIONS; ++d) {
+                    Dimension dim = static_cast<Dimension>(d);
+                    try {
+                        codeColumns[d].push_back(dictionaries[d].encode(dimensionValue(record, dim)));
+                    } catch (const length_error& e) {
+                        throw length_error(string(dimensionKey(dim)) + " has " + e.what());
+                    }
+                }
+                rows.push_back(&record);
+                totalProfit.push_back(record.totalProfit);
+                totalRevenue.push_back(record.totalRevenue);
+                totalCost.push_back(record.totalCost);
+                unitsSold.push_back(record.unitsSold);
+                orderDate.push_back(parseDate(record.orderDate));
+            }
+        }
+    }
+
+    void clear() {
+        for (int d = 0; d < NUM_DIMENSIONS; ++d) {
+            dictionaries[d].clear();
+            codeColumns[d].clear();
+        }
+        rows.clear();
+        totalProfit.clear();
+        totalRevenue.clear();
+        totalCost.clear();
+        unitsSold.clear();
+        orderDate.clear();
+    }
+
+    size_t size() const {
+        return rows.size();
+    }
+
+    const Dictionary& dictionary(Dimension dim) const {
+        return dictionaries[static_cast<int>(dim)];
+    }
+
+    const vector<uint16_t>& codes(Dimension dim) const {
+        return codeColumns[static_cast<int>(dim)];
+    }
+};
+
+#endif // SALES_TABLE_H
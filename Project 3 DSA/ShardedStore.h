@@ -0,0 +1,300 @@
+#ifndef SHARDED_STORE_H
+#define SHARDED_STORE_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <mutex>
+#include "SalesData.h"
+#include "CustomHashMap.h"
+#include "max_heap.h"
+#include "GroupAggregates.h"
+#include "HashPolicies.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// The loaded records split over N shards by a hash of the Order ID. Every
+// shard has its own hash map and heap, so a batch of new records is
+// inserted into all shards at once, one pool task per shard. A lookup only
+// touches the shard its Order ID hashes to; the top sale, full scans and
+// the aggregates run on every shard (in parallel where it pays) and merge.
+// With one shard this is exactly the single map and heap.
+class ShardedStore {
+public:
+    struct Shard {
+        CustomHashMap<> map;
+        max_heap heap;
+    };
+
+private:
+    vector<unique_ptr<Shard>> shards;
+
+    // Totals over all shards (one shard uses its own). Inserts only mark
+    // them stale; the first read afterwards merges the shards once, under
+    // a lock since several readers may share the data lock.
+    mutable GroupAggregates merged;
+    mutable bool mergedStale = false;
+    mutable mutex mergeMutex;
+
+    // independent of the polynomial hash the maps use for their buckets,
+    // so every shard still spreads over all of its buckets
+    WyHash hasher;
+
+    void mergeAggregates() const {
+        merged.clear();
+        for (const auto& shard : shards) {
+            merged.merge(shard->map.getAggregates());
+        }
+    }
+
+public:
+    // most shards "--shards" and "shards n" accept
+    static const size_t MAX_SHARDS = 256;
+
+    explicit ShardedStore(size_t numShards = 1) {
+        for (size_t s = 0; s < max<size_t>(numShards, 1); ++s) {
+            shards.emplace_back(new Shard());
+        }
+    }
+
+    // Drop every record, keeping the number of shards
+    void clear() {
+        size_t count = shards.size();
+        shards.clear();
+        for (size_t s = 0; s < count; ++s) {
+            shards.emplace_back(new Shard());
+        }
+        lock_guard<mutex> lock(mergeMutex);
+        merged.clear();
+        mergedStale = false;
+    }
+
+    size_t numShards() const {
+        return shards.size();
+    }
+
+    size_t shardOf(const string& orderID) const {
+        return shards.size() == 1 ? 0 : (hasher(orderID) >> 32) % shards.size();
+    }
+
+    Shard& shard(size_t index) {
+        return *shards[index];
+    }
+
+    const Shard& shard(size_t index) const {
+        return *shards[index];
+    }
+
+    size_t getNum_Records() {
+        size_t total = 0;
+        for (auto& shard : shards) total += shard->map.getNum_Records();
+        return total;
+    }
+
+    // Insert a batch into the heaps and maps, each shard's records (in
+    // batch order) on their own pool task
+    void insertBatch(vector<SalesData>& batch, ThreadPool& pool) {
+        if (shards.size() == 1) {
+            for (SalesData& record : batch) {
+                shards[0]->heap.insert(record);
+                shards[0]->map.insert(record);
+            }
+            return;
+        }
+        vector<vector<uint32_t>> parts(shards.size());
+        for (uint32_t i = 0; i < batch.size(); ++i) {
+            parts[shardOf(batch[i].orderID)].push_back(i);
+        }
+        parallelFor(pool, 0, shards.size(), 1, [&](size_t first, size_t last) {
+            for (size_t s = first; s < last; ++s) {
+                for (uint32_t i : parts[s]) {
+                    shards[s]->heap.insert(batch[i]);
+                    shards[s]->map.insert(batch[i]);
+                }
+            }
+        });
+        mergedStale = true;
+    }
+
+    // Spread the records over numShards shards. Every shard fills its map
+    // and builds its heap bottom up on its own pool task.
+    void reshard(size_t numShards, ThreadPool& pool) {
+        vector<SalesData> records;
+        records.reserve(getNum_Records());
+        for (const auto& shard : shards) {
+            for (const auto& bucket : shard->map.getBuckets()) {
+                records.insert(records.end(), bucket.begin(), bucket.end());
+            }
+        }
+        shards.clear();
+        for (size_t s = 0; s < max<size_t>(numShards, 1); ++s) {
+            shards.emplace_back(new Shard());
+        }
+        vector<vector<uint32_t>> parts(shards.size());
+        for (uint32_t i = 0; i < records.size(); ++i) {
+            parts[shardOf(records[i].orderID)].push_back(i);
+        }
+        parallelFor(pool, 0, shards.size(), 1, [&](size_t first, size_t last) {
+            for (size_t s = first; s < last; ++s) {
+                vector<SalesData> heapItems;
+                heapItems.reserve(parts[s].size());
+                for (uint32_t i : parts[s]) {
+                    shards[s]->map.insert(records[i]);
+                    heapItems.push_back(records[i]);
+                }
+                shards[s]->heap.build(move(heapItems));
+            }
+        });
+        mergedStale = true;
+    }
+
+    SalesData* find(const string& orderID) {
+        return shards[shardOf(orderID)]->map.find(orderID);
+    }
+
+    // findMany() on every shard for the keys that hash to it
+    void findMany(const vector<string>& orderIDs, vector<SalesData*>& results) {
+        if (shards.size() == 1) {
+            shards[0]->map.findMany(orderIDs, results);
+            return;
+        }
+        vector<vector<string>> keys(shards.size());
+        vector<vector<size_t>> positions(shards.size());
+        for (size_t i = 0; i < orderIDs.size(); ++i) {
+            size_t s = shardOf(orderIDs[i]);
+            keys[s].push_back(orderIDs[i]);
+            positions[s].push_back(i);
+        }
+        results.assign(orderIDs.size(), nullptr);
+        vector<SalesData*> found;
+        for (size_t s = 0; s < shards.size(); ++s) {
+            shards[s]->map.findMany(keys[s], found);
+            for (size_t k = 0; k < found.size(); ++k) results[positions[s][k]] = found[k];
+        }
+    }
+
+    // Linear search of the heap of the Order ID's shard
+    const SalesData* findInHeap(const string& orderID) const {
+        for (const SalesData& record : shards[shardOf(orderID)]->heap.getHeap()) {
+            if (record.getID() == orderID) return &record;
+        }
+        return nullptr;
+    }
+
+    // Top sale from the heaps: the best of the shard roots
+    pair<string, SalesData> extractMax() const {
+        const SalesData* best = nullptr;
+        for (const auto& shard : shards) {
+            if (shard->heap.isEmpty()) continue;
+            const SalesData& root = shard->heap.getHeap()[0];
+            if (best == nullptr || root.totalProfit > best->totalProfit) best = &root;
+        }
+        if (best == nullptr) {
+            throw out_of_range("Heap is empty");
+        }
+        return make_pair(best->orderID, *best);
+    }
+
+    // Top sale from a scan of the maps, every shard scanned on its own
+    // pool task; nullptr if nothing is loaded
+    const SalesData* highestProfitRecord(ThreadPool& pool) const {
+        typedef const SalesData* Best;
+        return parallelReduce<Best>(pool, 0, shards.size(), 1, nullptr,
+            [this](size_t first, size_t last) {
+                Best best = nullptr;
+                for (size_t s = first; s < last; ++s) {
+                    for (const auto& bucket : shards[s]->map.getBuckets()) {
+                        for (const auto& record : bucket) {
+                            if (best == nullptr || record.totalProfit > best->totalProfit) best = &record;
+                        }
+                    }
+                }
+                return best;
+            },
+            [](Best left, Best right) {
+                return right != nullptr && (left == nullptr || right->totalProfit > left->totalProfit) ? right : left;
+            });
+    }
+
+    // Records above a profit threshold from every shard's heap, shard by shard
+    void collectAbove(double threshold, vector<const SalesData*>& out, ThreadPool& pool) const {
+        if (shards.size() == 1) {
+            shards[0]->heap.collectAbove(threshold, out);
+            return;
+        }
+        vector<vector<const SalesData*>> parts(shards.size());
+        parallelFor(pool, 0, shards.size(), 1, [&](size_t first, size_t last) {
+            for (size_t s = first; s < last; ++s) shards[s]->heap.collectAbove(threshold, parts[s]);
+        });
+        for (const auto& part : parts) out.insert(out.end(), part.begin(), part.end());
+    }
+
+    // Totals maintained by the maps, merged over the shards
+    const GroupAggregates& getAggregates() const {
+        if (shards.size() == 1) return shards[0]->map.getAggregates();
+        lock_guard<mutex> lock(mergeMutex);
+        if (mergedStale) {
+            mergeAggregates();
+            mergedStale = false;
+        }
+        return merged;
+    }
+
+    // Recompute the profit total per group from the records; one shard
+    // splits its buckets over the pool, several shards scan in parallel
+    // and merge in shard order
+    vector<pair<string,double>> scanTotals(string SalesData::* field, ThreadPool& pool) const {
+        if (shards.size() == 1) {
+            return shards[0]->map.scanTotals(field, pool);
+        }
+        vector<vector<pair<string,double>>> parts(shards.size());
+        parallelFor(pool, 0, shards.size(), 1, [&](size_t first, size_t last) {
+            for (size_t s = first; s < last; ++s) parts[s] = shards[s]->map.scanTotals(field);
+        });
+        GroupTotals totals;
+        for (const auto& part : parts) {
+            for (const auto& group : part) totals.add(group.first, group.second);
+        }
+        return totals.get();
+    }
+
+    void aggregateByRegion(ResultWriter& out) const {
+        writeRegionTotals(getAggregates(), out);
+    }
+
+    void aggregateByCountry(ResultWriter& out) const {
+        writeCountryTotals(getAggregates(), out);
+    }
+
+    void topPerformingItems(int n, ResultWriter& out) const {
+        writeTopItems(getAggregates(), n, out);
+    }
+
+    // Call visit(buckets) with the buckets of every shard's map in turn
+    template <typename Visitor>
+    void forEachBuckets(Visitor visit) const {
+        for (const auto& shard : shards) visit(shard->map.getBuckets());
+    }
+
+    void printHashStats() const {
+        for (size_t s = 0; s < shards.size(); ++s) {
+            if (shards.size() > 1) cout << "\nShard " << s + 1 << " of " << shards.size() << ":";
+            shards[s]->map.printHashStats();
+        }
+    }
+
+    // Records per shard
+    void printShards() {
+        cout << "\n--- Shards ---\n";
+        cout << "Shards: " << shards.size() << ", records: " << getNum_Records() << "\n";
+        for (size_t s = 0; s < shards.size(); ++s) {
+            cout << "  shard " << s + 1 << ": " << shards[s]->map.getNum_Records() << " records, heap "
+                 << shards[s]->heap.size() << "\n";
+        }
+    }
+};
+
+#endif // SHARDED_STORE_H
@@ -0,0 +1,184 @@
+#ifndef SKETCHES_H
+#define SKETCHES_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "HashPolicies.h"
+
+using namespace std;
+
+// HyperLogLog distinct counter: 2^PRECISION one-byte registers, each
+// holding the longest run of leading zeros seen among the hashes routed to
+// it. Fixed memory regardless of how many values are added.
+class HyperLogLog {
+private:
+    static const int PRECISION = 12;
+    static const int NUM_REGISTERS = 1 << PRECISION;
+
+    vector<uint8_t> registers;
+    WyHash hasher;
+
+public:
+    HyperLogLog() : registers(NUM_REGISTERS, 0) {}
+
+    void add(const string& value) {
+        uint64_t hash = hasher(value);
+        size_t index = hash >> (64 - PRECISION);
+        uint64_t rest = hash << PRECISION;
+        uint8_t rank = rest == 0 ? 64 - PRECISION + 1 : __builtin_clzll(rest) + 1;
+        if (rank > registers[index]) registers[index] = rank;
+    }
+
+    double estimate() const {
+        double m = NUM_REGISTERS;
+        double sum = 0;
+        size_t zeros = 0;
+        for (uint8_t r : registers) {
+            sum += ldexp(1.0, -r);
+            if (r == 0) zeros++;
+        }
+        double alpha = 0.7213 / (1 + 1.079 / m);
+        double raw = alpha * m * m / sum;
+        // small cardinalities: linear counting over the empty registers is more accurate
+        if (raw <= 2.5 * m && zeros > 0) {
+            return m * log(m / zeros);
+        }
+        return raw;
+    }
+
+    // Count everything the other counter has seen as well
+    void merge(const HyperLogLog& other) {
+        for (size_t i = 0; i < registers.size(); ++i) {
+            registers[i] = max(registers[i], other.registers[i]);
+        }
+    }
+
+    // standard error of the estimate, relative
+    static double relativeError() {
+        return 1.04 / sqrt(static_cast<double>(NUM_REGISTERS));
+    }
+
+    size_t memoryBytes() const {
+        return registers.size();
+    }
+};
+
+// KLL quantile sketch: a stack of compactors. Level h holds items that each
+// stand for 2^h inputs; when a level is full it is sorted and every other
+// item (random offset) is promoted to the next level. Lower levels get
+// smaller capacities, so memory stays around 3k items for any input size.
+class KllSketch {
+private:
+    static const int K = 200;
+
+    vector<vector<double>> levels;
+    size_t count = 0;
+    size_t retained = 0;
+    size_t totalCapacity = 0;
+    uint64_t rngState = 0x9e3779b97f4a7c15ULL;
+
+    size_t capacity(size_t level) const {
+        size_t depth = levels.size() - level - 1;
+        return max<size_t>(2, static_cast<size_t>(ceil(K * pow(2.0 / 3.0, static_cast<double>(depth)))));
+    }
+
+    bool randomBit() {
+        rngState ^= rngState << 13;
+        rngState ^= rngState >> 7;
+        rngState ^= rngState << 17;
+        return rngState & 1;
+    }
+
+    void updateCapacity() {
+        totalCapacity = 0;
+        for (size_t level = 0; level < levels.size(); ++level) totalCapacity += capacity(level);
+    }
+
+    void compress() {
+        for (size_t level = 0; level < levels.size(); ++level) {
+            if (levels[level].size() < capacity(level)) continue;
+            if (level + 1 == levels.size()) {
+                levels.emplace_back();
+                updateCapacity();
+            }
+            vector<double>& items = levels[level];
+            size_t before = items.size() + levels[level + 1].size();
+            sort(items.begin(), items.end());
+            size_t odd = items.size() % 2;
+            for (size_t i = odd + (randomBit() ? 1 : 0); i < items.size(); i += 2) {
+                levels[level + 1].push_back(items[i]);
+            }
+            // an odd leftover stays behind with its weight
+            double leftover = odd ? items[0] : 0;
+            items.clear();
+            if (odd) items.push_back(leftover);
+            retained -= before - items.size() - levels[level + 1].size();
+            return;
+        }
+    }
+
+public:
+    KllSketch() : levels(1) {
+        updateCapacity();
+    }
+
+    void add(double value) {
+        levels[0].push_back(value);
+        count++;
+        retained++;
+        if (retained >= totalCapacity) compress();
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Add the other sketch's items level by level, then compact until the
+    // result fits again
+    void merge(const KllSketch& other) {
+        if (other.levels.size() > levels.size()) {
+            levels.resize(other.levels.size());
+            updateCapacity();
+        }
+        for (size_t level = 0; level < other.levels.size(); ++level) {
+            levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+        }
+        count += other.count;
+        retained += other.retained;
+        while (retained >= totalCapacity) compress();
+    }
+
+    // value at quantile q in [0, 1]
+    double quantile(double q) const {
+        vector<pair<double, size_t>> weighted;
+        for (size_t level = 0; level < levels.size(); ++level) {
+            for (double v : levels[level]) weighted.emplace_back(v, size_t(1) << level);
+        }
+        if (weighted.empty()) return 0;
+        sort(weighted.begin(), weighted.end());
+        size_t total = 0;
+        for (const auto& w : weighted) total += w.second;
+        double target = q * total;
+        size_t cumulative = 0;
+        for (const auto& w : weighted) {
+            cumulative += w.second;
+            if (cumulative >= target) return w.first;
+        }
+        return weighted.back().first;
+    }
+
+    // normalized rank error at ~99% confidence for this K, using the
+    // constants the DataSketches KLL implementation publishes
+    static double rankError() {
+        return 2.446 / pow(static_cast<double>(K), 0.9433);
+    }
+
+    size_t memoryBytes() const {
+        return retained * sizeof(double);
+    }
+};
+
+#endif // SKETCHES_H
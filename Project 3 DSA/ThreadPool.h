@@ -0,0 +1,233 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+// Work-stealing thread pool. Every worker owns a deque: tasks it spawns go
+// on the back and it takes its own work from the back (newest first, still
+// warm in cache), while idle workers steal from the front of the others
+// (oldest first, usually the biggest pieces). Tasks submitted from outside
+// the pool are spread over the deques round robin. A thread waiting on a
+// TaskGroup runs queued tasks before it blocks, and only blocks on tasks
+// that are already running, so nested parallel loops cannot deadlock the
+// pool.
+class ThreadPool {
+private:
+    struct Worker {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<Worker>> queues;
+    vector<thread> threads;
+    atomic<size_t> nextQueue{0};
+
+    // queued tasks, workers sleep while it is zero
+    mutex sleepMutex;
+    condition_variable wake;
+    atomic<size_t> pending{0};
+    bool stopping = false;
+
+    static ThreadPool*& currentPool() {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& currentIndex() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    bool popOwn(size_t self, function<void()>& task) {
+        Worker& worker = *queues[self];
+        lock_guard<mutex> lock(worker.lock);
+        if (worker.tasks.empty()) return false;
+        task = move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t start, function<void()>& task) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            Worker& victim = *queues[(start + i) % queues.size()];
+            lock_guard<mutex> lock(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        currentPool() = this;
+        currentIndex() = self;
+        while (true) {
+            if (runPending()) continue;
+            unique_lock<mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || pending.load() > 0; });
+            if (stopping && pending.load() == 0) return;
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t numThreads = thread::hardware_concurrency()) {
+        numThreads = max<size_t>(numThreads, 1);
+        for (size_t i = 0; i < numThreads; ++i) {
+            queues.emplace_back(new Worker());
+        }
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool shared by the whole program, one worker per hardware thread
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t size() const {
+        return threads.size();
+    }
+
+    void submit(function<void()> task) {
+        size_t target = currentPool() == this ? currentIndex() : nextQueue++ % queues.size();
+        // count the task before it can be taken, so runPending never
+        // decrements pending below zero
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            pending++;
+        }
+        {
+            lock_guard<mutex> lock(queues[target]->lock);
+            queues[target]->tasks.push_back(move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Run one queued task on the calling thread: a worker takes its own
+    // newest task first, anyone else steals. False if nothing was queued.
+    bool runPending() {
+        function<void()> task;
+        bool onWorker = currentPool() == this;
+        size_t self = onWorker ? currentIndex() : 0;
+        if (!(onWorker && popOwn(self, task)) && !steal(onWorker ? self + 1 : 0, task)) {
+            return false;
+        }
+        pending--;
+        task();
+        return true;
+    }
+};
+
+// Tasks that are waited for together
+class TaskGroup {
+private:
+    ThreadPool& pool;
+    atomic<size_t> outstanding{0};
+
+    // wait() sleeps here once nothing is left to help with
+    mutex doneMutex;
+    condition_variable done;
+
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+
+    ~TaskGroup() {
+        wait();
+    }
+
+    void run(function<void()> task) {
+        outstanding++;
+        pool.submit([this, task = move(task)] {
+            task();
+            lock_guard<mutex> lock(doneMutex);
+            if (--outstanding == 0) done.notify_all();
+        });
+    }
+
+    // Help with queued tasks until none are left, then sleep until every
+    // task of the group has finished. The last check is made under the
+    // lock, so no task is still notifying when the group goes away.
+    void wait() {
+        while (outstanding.load() > 0 && pool.runPending()) {}
+        unique_lock<mutex> lock(doneMutex);
+        done.wait(lock, [this] { return outstanding.load() == 0; });
+    }
+};
+
+// Chunk size giving every pool thread (and the caller) a few chunks to
+// balance uneven work
+inline size_t defaultGrain(size_t count, const ThreadPool& pool) {
+    return max<size_t>(1, count / ((pool.size() + 1) * 4));
+}
+
+// body(first, last) for consecutive chunks of [begin, end) of at most grain
+// indexes, run in parallel; the calling thread takes part
+template <typename Body>
+void parallelFor(ThreadPool& pool, size_t begin, size_t end, size_t grain, const Body& body) {
+    if (begin >= end) return;
+    grain = max<size_t>(grain, 1);
+    if (end - begin <= grain) {
+        body(begin, end);
+        return;
+    }
+    TaskGroup group(pool);
+    size_t first = begin;
+    // keep the first chunk for the calling thread
+    for (size_t chunk = begin + grain; chunk < end; chunk += grain) {
+        size_t last = min(end, chunk + grain);
+        group.run([&body, chunk, last] { body(chunk, last); });
+    }
+    body(first, min(end, begin + grain));
+    group.wait();
+}
+
+// Reduce [begin, end) in chunks: map(first, last) gives each chunk's value
+// and the values are folded with combine from left to right, so the result
+// does not depend on which thread ran which chunk
+template <typename T, typename Map, typename Combine>
+T parallelReduce(ThreadPool& pool, size_t begin, size_t end, size_t grain, T identity,
+                 const Map& map, const Combine& combine) {
+    if (begin >= end) return identity;
+    grain = max<size_t>(grain, 1);
+    size_t chunks = (end - begin + grain - 1) / grain;
+    vector<T> partial(chunks, identity);
+    parallelFor(pool, 0, chunks, 1, [&](size_t firstChunk, size_t lastChunk) {
+        for (size_t c = firstChunk; c < lastChunk; ++c) {
+            size_t first = begin + c * grain;
+            partial[c] = map(first, min(end, first + grain));
+        }
+    });
+    T result = move(identity);
+    for (auto& value : partial) {
+        result = combine(move(result), move(value));
+    }
+    return result;
+}
+
+#endif // THREAD_POOL_H
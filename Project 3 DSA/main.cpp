@@ -3,24 +3,202 @@
 #include <fstream>
 #include <algorithm>
 #include <chrono>
+#include <random>
+#include <unordered_set>
+#include <climits>
+#include <charconv>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#include <glob.h>
+#endif
 #include "max_heap.h"
 #include "CustomHashMap.h"
+#include "ShardedStore.h"
+#include "HashBenchmark.h"
+#include "ConcurrentMapBenchmark.h"
+#include "PoolBenchmark.h"
+#include "BloomFilter.h"
+#include "SalesTable.h"
+#include "InvertedIndex.h"
+#include "OrderIdIndex.h"
+#include "ProfitRanks.h"
+#include "Cube.h"
+#include "Query.h"
+#include "QueryCache.h"
+#include "ReservoirSample.h"
+#include "LoadPipeline.h"
+#include "ArchiveReader.h"
+#ifdef __linux__
+#include "QueryServer.h"
+#include "LoadGenerator.h"
+#include "FileBlockReader.h"
+#include "ReadBenchmark.h"
+#endif
 
 using namespace std;
 
+// Points cout at another buffer for as long as it lives, so the real one is
+// put back even when the command in between throws
+class CoutRedirect {
+private:
+    streambuf* previous;
+
+public:
+    explicit CoutRedirect(streambuf* target) : previous(cout.rdbuf(target)) {}
+
+    ~CoutRedirect() {
+        cout.rdbuf(previous);
+    }
+
+    CoutRedirect(const CoutRedirect&) = delete;
+    CoutRedirect& operator=(const CoutRedirect&) = delete;
+};
+
+// Parse text made only of digits as a count of at most maxValue;
+// false for anything else, including a number too large to hold
+static bool parseCount(const string& text, size_t maxValue, size_t& value) {
+    size_t parsed = 0;
+    auto result = from_chars(text.data(), text.data() + text.size(), parsed);
+    if (text.empty() || result.ec != errc() || result.ptr != text.data() + text.size() || parsed > maxValue) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
 class SalesDataCLI {
 private:
-    // Sales data stored in an unordered map with Order ID as key
-    CustomHashMap salesMap;
-    max_heap salesHeap;
+    // Sales data in a hash map with Order ID as key and a heap by profit,
+    // split over shards by Order ID (one shard unless --shards or "shards")
+    ShardedStore salesStore;
     string filename;
 
+    // Bloom filter over every loaded Order ID, checked before the heap and map
+    BloomFilter orderFilter;
+    bool useBloomFilter = true;
+
+    // Columnar copy of the records and the secondary indexes over it,
+    // rebuilt after every load
+    SalesTable salesTable;
+    SecondaryIndexes salesIndexes;
+
+    // Batch mode prints records on one line each
+    bool compactOutput = false;
+
+    // Renders result tables as plain text, CSV or JSON
+    ResultWriter defaultWriter;
+
+    // Output of one server request: its own text and result writer, so
+    // several requests can run at once
+    struct RequestOutput {
+        ostringstream text;
+        ResultWriter writer;
+        bool failed = false; // the command printed an error, not a result
+
+        explicit RequestOutput(OutputFormat format) {
+            writer.setFormat(format);
+            writer.setOutput(text);
+        }
+    };
+
+    // Request whose output this thread is producing, null for the CLI
+    static RequestOutput*& currentRequest() {
+        static thread_local RequestOutput* request = nullptr;
+        return request;
+    }
+
+    // Sends this thread's output() and writer() to a request while it lives
+    class RequestScope {
+    private:
+        RequestOutput* previous;
+
+    public:
+        explicit RequestScope(RequestOutput& request) : previous(currentRequest()) {
+            currentRequest() = &request;
+        }
+
+        ~RequestScope() {
+            currentRequest() = previous;
+        }
+
+        RequestScope(const RequestScope&) = delete;
+        RequestScope& operator=(const RequestScope&) = delete;
+    };
+
+    // Where commands print: cout, or the running request's buffer
+    ostream& output() {
+        RequestOutput* request = currentRequest();
+        return request ? request->text : cout;
+    }
+
+    ResultWriter& writer() {
+        RequestOutput* request = currentRequest();
+        return request ? request->writer : defaultWriter;
+    }
+
+    // Called where a command rejects its arguments, so runCommand does not
+    // cache the error message as if it were a result
+    void markFailed() {
+        RequestOutput* request = currentRequest();
+        if (request) request->failed = true;
+    }
+
+    // Sorted Order ID index for range and nearest-ID queries
+    OrderIdIndex orderIdIndex;
+
+    // Every profit in sorted order for rank and percentile queries
+    ProfitRanks profitRanks;
+
+    // Output of aggregation commands, valid while the dataset version holds;
+    // the version goes up whenever records are added
+    QueryCache queryCache;
+    mutex cacheMutex;
+    uint64_t datasetVersion = 0;
+
+    // Uniform sample of the loaded records for --approx answers
+    ReservoirSample salesSample;
+
+    // Background loading. The loader publishes parsed records in batches
+    // under an exclusive lock on dataMutex; every command holds a shared
+    // lock while it runs, so it sees whole batches in the heap, the map and
+    // the aggregates alike. Commands that need the indexes wait for the load.
+    thread loaderThread;
+    shared_mutex dataMutex;
+    atomic<bool> loading{false};
+    atomic<bool> cancelLoad{false};
+    atomic<size_t> rowsIngested{0};
+    atomic<size_t> bytesIngested{0};
+    size_t bytesTotal = 0;
+    std::chrono::high_resolution_clock::time_point loadStart;
+    bool backgroundLoads = true;
+
+    // Set by serve(): settings shared by every client cannot be changed
+    bool serving = false;
+
+    // Per-stage timings of the last load, shown by "loadstats"
+    LoadPipeline::Stats lastLoadStats;
+
+    // What the background loader would have printed, shown by the CLI
+    // after the next command
+    mutex messageMutex;
+    string loadMessages;
+
     // Trim whitespace from string
     string trim(const string& str) {
         auto start = str.begin();
         while (start != str.end() && isspace(*start)) {
             start++;
         }
+        if (start == str.end()) return "";
 
         auto end = str.end();
         do {
@@ -34,7 +212,7 @@ private:
     string promptForFilename() {
         string input;
         while (true) {
-            cout << "Enter the path to your CSV file: ";
+            output() << "Enter the path to your CSV file: ";
             getline(cin, input);
 
             input = trim(input);
@@ -52,7 +230,7 @@ private:
                 return input;
             }
 
-            cout << "Error: Could not open file. Please try again.\n";
+            output() << "Error: Could not open file. Please try again.\n";
         }
     }
 
@@ -67,287 +245,2179 @@ private:
 public:
     SalesDataCLI() : filename("") {}
 
-    // Read CSV file and populate sales map
-    bool readCSV() {
+    // runCLI() loads this file before showing the menu
+    explicit SalesDataCLI(const string& file) : filename(file) {}
+
+    ~SalesDataCLI() {
+        cancelLoad = true;
+        if (loaderThread.joinable()) {
+            loaderThread.join();
+        }
+    }
+
+    // Open the CSV file to load, prompting for the path if none was given
+    bool openDataFile(ifstream& file) {
         // If no filename, prompt user
         if (filename.empty()) {
             filename = promptForFilename();
         }
 
-        ifstream file(filename);
+        file.open(filename, ios::binary);
         if (!file.is_open()) {
             cerr << "Could not open file: " << filename << endl;
             return false;
         }
+        file.seekg(0, ios::end);
+        bytesTotal = static_cast<size_t>(file.tellg());
+        file.seekg(0, ios::beg);
+        return true;
+    }
 
-        // Skip header
-        string line;
-        getline(file, line);
+    // Read CSV file and populate sales map
+    bool readCSV() {
+        ifstream file;
+        if (!openDataFile(file)) {
+            return false;
+        }
+        loadStart = std::chrono::high_resolution_clock::now();
+        ingestFile(file, output(), cerr);
+        return true;
+    }
+
+    // Load the CSV file on a background thread and return to the prompt
+    bool startBackgroundLoad() {
+        ifstream file;
+        if (!openDataFile(file)) {
+            return false;
+        }
+        runLoader([this, file = move(file)](ostream& log) mutable { ingestFile(file, log, log); });
+        return true;
+    }
 
-        int lineCount = 0;
-        while (getline(file, line)) {
-            // insert into map
-            stringstream ss(line);
-            SalesData record;
-            string field;
+    // Run load(log) on the loader thread; what it prints is shown by the CLI
+    // once it is done
+    template <typename Load>
+    void runLoader(Load load) {
+        loadStart = std::chrono::high_resolution_clock::now();
+        loading = true;
+        cancelLoad = false;
+        loaderThread = thread([this, load = move(load)]() mutable {
+            ostringstream log;
+            load(log);
+            lock_guard<mutex> lock(messageMutex);
+            loadMessages += log.str();
+            loading = false;
+        });
+        output() << "Loading " << filename << " in the background. Enter \"progress\" to check on it"
+             << " or \"wait\" to wait for it.\n";
+    }
 
-            try {
-                // Parse each field from the CSV
-                getline(ss, record.region, ',');
-                getline(ss, record.country, ',');
-                getline(ss, record.itemType, ',');
-                getline(ss, record.salesChannel, ',');
-                getline(ss, record.orderPriority, ',');
-                getline(ss, record.orderDate, ',');
+    // Insert parsed records into every structure as one batch
+    void publishBatch(vector<SalesData>& batch) {
+        unique_lock<shared_mutex> lock(dataMutex);
+        // Insert into the heap and map of every record's shard
+        salesStore.insertBatch(batch, ThreadPool::shared());
+        for (SalesData& record : batch) {
+            // Remember the Order ID for fast negative lookups
+            orderFilter.insert(record.orderID);
 
-                // Order ID is the key
-                string orderID;
-                getline(ss, record.orderID, ',');
+            // Keep the sample uniform over everything loaded
+            salesSample.add(record);
+        }
+        rowsIngested += batch.size();
+        // cached results no longer describe the data
+        datasetVersion++;
+        batch.clear();
+    }
 
-                getline(ss, record.shipDate, ',');
+    // Parse the rows of an open CSV file and publish them in batches.
+    // A gzip file or zip archive is decompressed on the fly.
+    void ingestFile(ifstream& file, ostream& out, ostream& err) {
+        ArchiveKind kind = detectArchive(file);
+        if (kind == ArchiveKind::Plain) {
+            ingest(LoadPipeline::streamSource(file), bytesTotal, out, err);
+            return;
+        }
+        ArchiveReader archive(file, kind, filename);
+        // expect more rows than the compressed size suggests
+        ingest(archive.source(), bytesTotal * ARCHIVE_EXPANSION, out, err);
+        if (!archive.error().empty()) {
+            err << archive.error() << "\n";
+        }
+        out << "Decompressed " << archive.bytesProduced() << " bytes from the " << archiveKindName(kind) << " file";
+        if (kind == ArchiveKind::Zip) {
+            out << " (" << archive.entriesSeen() << (archive.entriesSeen() == 1 ? " entry)" : " entries)");
+        }
+        out << ".\n";
+    }
 
-                getline(ss, field, ',');
-                record.unitsSold = stoi(field);
+    // Parse the CSV data a source gives and publish it in batches;
+    // expectedBytes is roughly how much CSV text it holds
+    void ingest(const LoadPipeline::Source& source, size_t expectedBytes, ostream& out, ostream& err) {
+        rowsIngested = 0;
+        bytesIngested = 0;
 
-                getline(ss, field, ',');
-                record.unitPrice = stod(field);
+        // Size the Bloom filter for the records already loaded plus an
+        // estimate of this file (rows are well over 100 bytes), re-adding the
+        // existing Order IDs if it has to grow
+        {
+            unique_lock<shared_mutex> lock(dataMutex);
+            size_t estimatedRows = expectedBytes / 100;
+            size_t neededCapacity = salesStore.getNum_Records() + estimatedRows;
+            if (orderFilter.capacity() < neededCapacity) {
+                orderFilter.reset(neededCapacity);
+                salesStore.forEachBuckets([this](const vector<vector<SalesData>>& buckets) {
+                    for (const auto& bucket : buckets) {
+                        for (const auto& record : bucket) {
+                            orderFilter.insert(record.orderID);
+                        }
+                    }
+                });
+            }
+        }
 
-                getline(ss, field, ',');
-                record.unitCost = stod(field);
+        // read, split, parse and insert run as a pipeline; publishing is the
+        // insert stage, so batches still arrive whole and in file order
+        LoadPipeline pipeline;
+        pipeline.run(source, [this](vector<SalesData>& batch) { publishBatch(batch); }, err,
+                     bytesIngested, cancelLoad);
 
-                getline(ss, field, ',');
-                record.totalRevenue = stod(field);
+        // "loadstats" reads these under the data lock
+        unique_lock<shared_mutex> lock(dataMutex);
+        lastLoadStats = pipeline.lastStats();
+        size_t lineCount = lastLoadStats.rows;
+        if (cancelLoad) {
+            // only exiting cancels a load, so the indexes are not rebuilt
+            out << "Load cancelled after " << lineCount << " records from " << filename << ".\n";
+            return;
+        }
+        out << "Successfully loaded " << salesStore.getNum_Records() << " records from "
+             << filename << ".\n";
+
+        // cached results no longer describe the data
+        datasetVersion++;
+
+        buildIndexes(out);
+    }
+
+#ifdef __linux__
+    // Load every CSV file of a directory through FileBlockReader, which
+    // keeps many reads in flight with io_uring (pread where that is not
+    // available), in the background unless batch mode wants it done first
+    bool loadDirectory(const string& dir) {
+        vector<string> files;
+        string error;
+        if (!listCsvFiles(dir, files, error)) {
+            cerr << error << endl;
+            return false;
+        }
+        auto reader = make_shared<FileBlockReader>(files);
+        if (!reader->error().empty()) {
+            cerr << reader->error() << endl;
+            return false;
+        }
+        filename = dir;
+        bytesTotal = reader->totalBytes();
+        auto load = [this, reader, count = files.size()](ostream& out, ostream& err) {
+            ingest(reader->source(), reader->totalBytes(), out, err);
+            if (!reader->error().empty()) {
+                err << reader->error() << "\n";
+            }
+            out << "Read " << count << " files with " << reader->backend() << ".\n";
+        };
+        startLoad(load);
+        return true;
+    }
+#endif
 
-                getline(ss, field, ',');
-                record.totalCost = stod(field);
+    // Run load(out, err) on the loader thread, or right here when batch
+    // mode wants every load done before the next command
+    template <typename Load>
+    void startLoad(Load load) {
+        if (backgroundLoads) {
+            runLoader([load](ostream& log) { load(log, log); });
+        } else {
+            loadStart = std::chrono::high_resolution_clock::now();
+            load(output(), cerr);
+        }
+    }
 
-                getline(ss, field, ',');
-                record.totalProfit = stod(field);
+    // Load several CSV, gzip or zip files one after another as one load
+    bool loadFiles(const vector<string>& files, const string& label) {
+        auto reader = make_shared<FileSetReader>(files);
+        if (!reader->error().empty()) {
+            cerr << reader->error() << endl;
+            return false;
+        }
+        filename = label;
+        bytesTotal = reader->totalBytes();
+        startLoad([this, reader](ostream& out, ostream& err) {
+            ingest(reader->source(), reader->expectedBytes(), out, err);
+            if (!reader->error().empty()) {
+                err << reader->error() << "\n";
+            }
+            out << "Read " << reader->fileCount() << " files.\n";
+        });
+        return true;
+    }
 
-                // current record is no longer empty
-                record.isEmpty = false;
+    // Files a load argument names: the whole argument if it opens as a
+    // file, otherwise each word of it (quotes keep spaces in a word) with
+    // *, ? and [...] patterns expanded in sorted order. Anything else comes
+    // back as the one path, so opening it reports the error. Empty when a
+    // pattern matches nothing.
+    vector<string> expandLoadArgument(const string& text) {
+        string whole = text;
+        if (whole.size() >= 2 && (whole.front() == '"' || whole.front() == '\'') && whole.back() == whole.front()) {
+            whole = whole.substr(1, whole.length() - 2);
+        }
+        if (ifstream(whole).is_open()) {
+            return {whole};
+        }
 
-                // Insert into heap
-                salesHeap.insert(record);
+        vector<string> words;
+        string word;
+        char quote = 0;
+        bool inWord = false;
+        for (char c : text) {
+            if (quote) {
+                if (c == quote) quote = 0;
+                else word += c;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+                inWord = true;
+            } else if (isspace(static_cast<unsigned char>(c))) {
+                if (inWord) words.push_back(word);
+                word.clear();
+                inWord = false;
+            } else {
+                word += c;
+                inWord = true;
+            }
+        }
+        if (inWord) words.push_back(word);
 
-                // Insert into map
-                salesMap.insert(record);
-                lineCount++;
+        bool pattern = text.find_first_of("*?[") != string::npos;
+        if (!pattern && (words.size() < 2 || !ifstream(words[0]).is_open())) {
+            return {whole};
+        }
+        vector<string> files;
+        for (const string& w : words) {
+            if (w.find_first_of("*?[") == string::npos) {
+                files.push_back(w);
+                continue;
+            }
+#ifdef _WIN32
+            files.push_back(w);
+#else
+            glob_t matches;
+            if (glob(w.c_str(), 0, nullptr, &matches) != 0) {
+                output() << "No files match " << w << "\n";
+                globfree(&matches);
+                return {};
             }
-            catch (const exception& e) {
-                cerr << "Error parsing line " << lineCount + 2 << ": " << line << "\n";
-                cerr << "Exception: " << e.what() << "\n";
+            for (size_t i = 0; i < matches.gl_pathc; ++i) {
+                files.push_back(matches.gl_pathv[i]);
             }
+            globfree(&matches);
+#endif
         }
+        return files;
+    }
 
-        cout << "Successfully loaded " << salesMap.getNum_Records() << " records from "
-             << filename << ".\n";
-        return true;
+    // Block until a background load has finished
+    void waitForLoad() {
+        if (!loaderThread.joinable()) return;
+        if (loading) {
+            output() << "Waiting for the load to finish...\n";
+        }
+        loaderThread.join();
+        printLoadMessages();
+    }
+
+    // Show what a finished background load reported
+    void printLoadMessages() {
+        if (loaderThread.joinable() && !loading) {
+            loaderThread.join();
+        }
+        lock_guard<mutex> lock(messageMutex);
+        if (!loadMessages.empty()) {
+            output() << loadMessages;
+            loadMessages.clear();
+        }
+    }
+
+    // Rows and bytes ingested so far by the current or last load
+    void printProgress() {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - loadStart);
+        size_t rows = rowsIngested, bytes = bytesIngested;
+        output() << fixed << setprecision(1);
+        output() << (loading ? "Loading " : "Last load ") << (filename.empty() ? "(none)" : filename) << "\n";
+        output() << "Rows ingested:  " << rows << "\n";
+        output() << "Bytes read:     " << bytes << " of " << bytesTotal << " ("
+             << (bytesTotal ? 100.0 * bytes / bytesTotal : 0.0) << "%)\n";
+        if (loading) {
+            output() << "Elapsed (ms):   " << elapsed.count() << "\n";
+            output() << "Rows per second: " << rows * 1000.0 / max<long long>(elapsed.count(), 1) << "\n";
+        }
+    }
+
+    // Build the columnar table and the secondary indexes from the map
+    void buildIndexes(ostream& out) {
+        auto start = std::chrono::high_resolution_clock::now();
+        salesTable.clear();
+        try {
+            salesStore.forEachBuckets([this](const vector<vector<SalesData>>& buckets) { salesTable.append(buckets); });
+        } catch (const length_error& e) {
+            // 16-bit dictionary codes would collide; keep nothing rather
+            // than indexes and filters that mix up values
+            out << "Load failed: " << e.what() << ". All records were dropped.\n";
+            salesStore.clear();
+            orderFilter.reset(0);
+            salesSample = ReservoirSample();
+            salesTable.clear();
+        }
+        salesIndexes.build(salesTable);
+        orderIdIndex.build(salesTable);
+        profitRanks.build(salesTable);
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        out << "Built secondary indexes (" << salesIndexes.memoryBytes() / 1024 << " KiB) in "
+             << elapsed.count() << " ms.\n";
+    }
+
+    // CSV and JSON columns of a full record, after any columns in front
+    static vector<ResultWriter::Column> recordColumns(vector<ResultWriter::Column> columns = {}) {
+        columns.insert(columns.end(),
+                       {{"order_id", ""}, {"region", ""}, {"country", ""}, {"item_type", ""},
+                        {"sales_channel", ""}, {"order_priority", ""}, {"order_date", ""}, {"ship_date", ""},
+                        {"units_sold", ""}, {"unit_price", ""}, {"unit_cost", ""}, {"total_revenue", ""},
+                        {"total_cost", ""}, {"total_profit", ""}});
+        return columns;
+    }
+
+    // The cells of recordColumns() for one record
+    void writeRecordCells(const SalesData& record) {
+        writer().text(record.orderID);
+        writer().text(record.region);
+        writer().text(record.country);
+        writer().text(record.itemType);
+        writer().text(record.salesChannel);
+        writer().text(record.orderPriority);
+        writer().text(record.orderDate);
+        writer().text(record.shipDate);
+        writer().integer(record.unitsSold);
+        writer().money(record.unitPrice);
+        writer().money(record.unitCost);
+        writer().money(record.totalRevenue);
+        writer().money(record.totalCost);
+        writer().money(record.totalProfit);
+    }
+
+    // Print a full record, one tab-separated line in compact mode
+    void printRecord(const SalesData& record, const string& orderID) {
+        if (writer().format() != OutputFormat::Plain) {
+            writer().begin("Order Details", recordColumns());
+            writeRecordCells(record);
+            writer().endRow();
+            writer().end();
+        } else if (compactOutput) {
+            record.printCompact(output());
+        } else {
+            record.printDetails(orderID, output());
+        }
     }
 
     // Lookup a specific order by Order ID -- by map
     void lookupOrderMap(const string& orderID) {
-        auto it = salesMap.find(orderID);
+        if (useBloomFilter && !orderFilter.mightContain(orderID)) {
+            output() << "Order ID not found (Bloom filter): " << orderID << "\n";
+            return;
+        }
+        auto it = salesStore.find(orderID);
         if (it != nullptr) {
-            cout << "Search by ID Hashmap" << endl;
-            it->printDetails(orderID);
+            output() << "Search by ID Hashmap" << "\n";
+            printRecord(*it, orderID);
         } else {
-            cout << "Order ID not found: " << orderID << endl;
+            output() << "Order ID not found: " << orderID << "\n";
         }
     }
 
-    // Lookup a specific order by Order ID -- by heap
-    void looupOrderHeap(const string& orderID){
-        vector<SalesData> heap = salesHeap.getHeap();
-        for (int i = 0; i < heap.size(); i++) {
-            if (heap[i].getID() == orderID) {
-                cout << "Search by ID Heap" << endl;
-                heap[i].printDetails(orderID);
+    // Look up every Order ID listed in a file -- by map
+    // times find() one key at a time against the batched findMany()
+    void lookupBatch(const string& path) {
+        ifstream file(path);
+        if (!file.is_open()) {
+            output() << "Could not open file: " << path << endl;
+            return;
+        }
+        vector<string> orderIDs;
+        string orderID;
+        while (file >> orderID) {
+            orderIDs.push_back(orderID);
+        }
+        if (orderIDs.empty()) {
+            output() << "No Order IDs found in " << path << "\n";
+            return;
+        }
+
+        // one key at a time
+        size_t singleFound = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto& id : orderIDs) {
+            if (salesStore.find(id) != nullptr) singleFound++;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto singleElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        // batched with prefetching
+        vector<SalesData*> results;
+        start = std::chrono::high_resolution_clock::now();
+        salesStore.findMany(orderIDs, results);
+        end = std::chrono::high_resolution_clock::now();
+        auto batchElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        size_t batchFound = count_if(results.begin(), results.end(),
+                                     [](const SalesData* r) { return r != nullptr; });
+
+        double keys = static_cast<double>(orderIDs.size());
+        output() << fixed << setprecision(0);
+        output() << "\n--- Batch Lookup (" << orderIDs.size() << " Order IDs) ---\n";
+        output() << "Found:                       " << batchFound << " (" << orderIDs.size() - batchFound
+             << " not found)\n";
+        output() << "find() Elapsed Time (nanoseconds):     " << singleElapsed.count()
+             << " (" << keys * 1e9 / max<long long>(singleElapsed.count(), 1) << " keys/s)\n";
+        output() << "findMany() Elapsed Time (nanoseconds): " << batchElapsed.count()
+             << " (" << keys * 1e9 / max<long long>(batchElapsed.count(), 1) << " keys/s)\n";
+        if (singleFound != batchFound) {
+            output() << "Warning: find() found " << singleFound << " records\n";
+        }
+    }
+
+    // Orders matching every key=value filter, e.g. "country=Japan item=Baby Food",
+    // answered by intersecting the secondary index posting lists. Values may
+    // contain spaces; "limit=<n>" caps how many orders are printed (default 20).
+    void ordersMatching(istringstream& iss) {
+        vector<pair<string, string>> filters;
+        string token;
+        while (iss >> token) {
+            size_t eq = token.find('=');
+            if (eq != string::npos) {
+                filters.emplace_back(token.substr(0, eq), token.substr(eq + 1));
+            } else if (!filters.empty()) {
+                filters.back().second += " " + token;
+            } else {
+                output() << "Expected key=value, got: " << token << "\n";
+                return;
+            }
+        }
+
+        size_t limit = 20;
+        vector<PostingList> lists;
+        bool noMatch = false;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto& filter : filters) {
+            if (filter.first == "limit") {
+                if (!parseCount(filter.second, SIZE_MAX, limit)) {
+                    output() << "limit must be a number, got " << filter.second << "\n";
+                    return;
+                }
+                continue;
+            }
+            Dimension dim;
+            if (!parseDimension(filter.first, dim)) {
+                output() << "Unknown column: " << filter.first
+                     << " (use region, country, item, channel or priority)\n";
                 return;
             }
+            int code = salesTable.dictionary(dim).find(filter.second);
+            if (code < 0) {
+                noMatch = true;
+            } else {
+                lists.push_back(salesIndexes.index(dim).postings(static_cast<uint16_t>(code)));
+            }
+        }
+        if (lists.empty() && !noMatch) {
+            output() << "Please provide at least one filter, e.g. orders country=Japan item=Snacks\n";
+            return;
+        }
+
+        vector<uint32_t> matches;
+        if (!noMatch) {
+            matches = InvertedIndex::intersectAll(lists);
+        }
+        double profit = 0;
+        for (uint32_t id : matches) {
+            profit += salesTable.totalProfit[id];
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        writer().begin("Matching Orders",
+                     {{"order_id", ""}, {"region", "  "}, {"country", " / "}, {"item_type", " / "},
+                      {"sales_channel", " / "}, {"order_priority", " / "}, {"total_profit", "  $"}});
+        for (size_t i = 0; i < min(limit, matches.size()); ++i) {
+            const SalesData& record = *salesTable.rows[matches[i]];
+            writer().text(record.orderID);
+            writer().text(record.region);
+            writer().text(record.country);
+            writer().text(record.itemType);
+            writer().text(record.salesChannel);
+            writer().text(record.orderPriority);
+            writer().money(record.totalProfit);
+            writer().endRow();
+        }
+        writer().more(matches.size() - min(limit, matches.size()));
+        writer().summaryInteger("orders", "Orders:       ", matches.size());
+        writer().summaryMoney("total_profit", "Total Profit: $", profit);
+        writer().summaryInteger("elapsed_ns", "Index Elapsed Time (nanoseconds): ", elapsed.count());
+        writer().end();
+    }
+
+    // "lookup" in CSV or JSON: one row per structure that holds the order,
+    // with how long its search took
+    void writeLookup(const string& orderID) {
+        writer().begin("Order Lookup", recordColumns({{"source", ""}, {"elapsed_ns", ""}}));
+        bool mightExist = !useBloomFilter || orderFilter.mightContain(orderID);
+        auto row = [this](const char* source, const SalesData* record, long long ns) {
+            if (record == nullptr) return;
+            writer().text(source);
+            writer().integer(ns);
+            writeRecordCells(*record);
+            writer().endRow();
+        };
+        size_t found = 0;
+        for (int source = 0; source < 3; ++source) {
+            // the sorted index is rebuilt once the load finishes
+            if (source == 2 && loading) break;
+            auto start = std::chrono::high_resolution_clock::now();
+            const SalesData* record = nullptr;
+            if (mightExist && source == 0) {
+                record = salesStore.findInHeap(orderID);
+            } else if (mightExist && source == 1) {
+                record = salesStore.find(orderID);
+            } else if (mightExist) {
+                uint64_t key;
+                long long id = parseOrderID(orderID, key) ? orderIdIndex.find(key) : -1;
+                record = id >= 0 ? salesTable.rows[id] : nullptr;
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            row(source == 0 ? "heap" : source == 1 ? "hash_map" : "sorted_index", record,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            found += record != nullptr;
+        }
+        if (found == 0) {
+            writer().summaryText("not_found", "Order ID not found: ", orderID);
+        }
+        writer().end();
+    }
+
+    // Lookup a specific order by Order ID -- by sorted index
+    void lookupOrderIndex(const string& orderID) {
+        if (useBloomFilter && !orderFilter.mightContain(orderID)) {
+            output() << "Order ID not found in Sorted Index (Bloom filter): " << orderID << "\n";
+            return;
+        }
+        uint64_t key;
+        long long row = parseOrderID(orderID, key) ? orderIdIndex.find(key) : -1;
+        if (row >= 0) {
+            output() << "Search by ID Sorted Index" << "\n";
+            printRecord(*salesTable.rows[row], orderID);
+        } else {
+            output() << "Order ID not found in Sorted Index: " << orderID << "\n";
+        }
+    }
+
+    // Print every order whose ID lies in [low, high] -- by sorted index
+    void ordersInRange(uint64_t low, uint64_t high, size_t limit) {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto positions = orderIdIndex.range(low, high);
+        double profit = 0;
+        for (size_t p = positions.first; p < positions.second; ++p) {
+            profit += salesTable.totalProfit[orderIdIndex.rowAt(p)];
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        size_t count = positions.second - positions.first;
+        writer().begin("Orders with IDs " + to_string(low) + " to " + to_string(high),
+                     {{"order_id", ""}, {"country", "  "}, {"item_type", " / "}, {"total_profit", "  $"}});
+        for (size_t p = positions.first; p < positions.first + min(limit, count); ++p) {
+            const SalesData& record = *salesTable.rows[orderIdIndex.rowAt(p)];
+            writer().text(record.orderID);
+            writer().text(record.country);
+            writer().text(record.itemType);
+            writer().money(record.totalProfit);
+            writer().endRow();
+        }
+        writer().more(count - min(limit, count));
+        writer().summaryInteger("orders", "Orders:       ", count);
+        writer().summaryMoney("total_profit", "Total Profit: $", profit);
+        writer().summaryInteger("elapsed_ns", "Sorted Index Elapsed Time (nanoseconds): ", elapsed.count());
+        writer().end();
+    }
+
+    // Print the closest loaded Order IDs below and above an ID -- by sorted index
+    void nearestOrders(uint64_t key) {
+        long long exact = orderIdIndex.find(key);
+        long long below = orderIdIndex.predecessor(key);
+        long long above = orderIdIndex.successor(key);
+        if (writer().format() != OutputFormat::Plain) {
+            writer().begin("Nearest Order IDs to " + to_string(key),
+                         {{"order_id", ""}, {"exact", ""}, {"predecessor", ""}, {"successor", ""}});
+            writer().text(to_string(key));
+            if (exact >= 0) writer().text(salesTable.rows[exact]->orderID);
+            else writer().missing();
+            if (below >= 0) writer().text(to_string(orderIdIndex.keyAt(below)));
+            else writer().missing();
+            if (above >= 0) writer().text(to_string(orderIdIndex.keyAt(above)));
+            else writer().missing();
+            writer().endRow();
+            writer().end();
+            return;
+        }
+        output() << "\n--- Nearest Order IDs to " << key << " ---\n";
+        if (exact >= 0) {
+            output() << "Exact:        " << salesTable.rows[exact]->orderID << "\n";
+        }
+        if (below >= 0) {
+            output() << "Predecessor:  " << orderIdIndex.keyAt(below)
+                 << " (" << key - orderIdIndex.keyAt(below) << " below)\n";
+        } else {
+            output() << "Predecessor:  none\n";
+        }
+        if (above >= 0) {
+            output() << "Successor:    " << orderIdIndex.keyAt(above)
+                 << " (" << orderIdIndex.keyAt(above) - key << " above)\n";
+        } else {
+            output() << "Successor:    none\n";
+        }
+    }
+
+    // Orders with profit above a threshold -- pruned heap walk timed against
+    // a scan of the profit column
+    void ordersAbove(double threshold, size_t limit) {
+        vector<const SalesData*> heapMatches;
+        auto heapStart = std::chrono::high_resolution_clock::now();
+        salesStore.collectAbove(threshold, heapMatches, ThreadPool::shared());
+        auto heapEnd = std::chrono::high_resolution_clock::now();
+        auto heapElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(heapEnd - heapStart);
+
+        vector<uint32_t> scanMatches;
+        auto scanStart = std::chrono::high_resolution_clock::now();
+        const vector<double>& profits = salesTable.totalProfit;
+        for (uint32_t id = 0; id < profits.size(); ++id) {
+            if (profits[id] > threshold) scanMatches.push_back(id);
+        }
+        auto scanEnd = std::chrono::high_resolution_clock::now();
+        auto scanElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(scanEnd - scanStart);
+
+        // highest profit first for display
+        sort(heapMatches.begin(), heapMatches.end(),
+             [](const SalesData* a, const SalesData* b) { return a->totalProfit > b->totalProfit; });
+
+        string title = "Orders with Profit above $";
+        appendFixed2(title, threshold);
+        writer().begin(title, {{"rank", ""}, {"order_id", ". "}, {"country", "  "}, {"item_type", " / "},
+                             {"total_profit", "  $"}});
+        for (size_t i = 0; i < min(limit, heapMatches.size()); ++i) {
+            const SalesData& record = *heapMatches[i];
+            writer().integer(i + 1);
+            writer().text(record.orderID);
+            writer().text(record.country);
+            writer().text(record.itemType);
+            writer().money(record.totalProfit);
+            writer().endRow();
+        }
+        writer().more(heapMatches.size() - min(limit, heapMatches.size()));
+        writer().summaryInteger("orders", "Orders: ", heapMatches.size());
+        if (heapMatches.size() != scanMatches.size()) {
+            writer().summaryText("warning", "Warning: ",
+                               "column scan found " + to_string(scanMatches.size()) + " orders");
+        }
+        writer().summaryInteger("heap_elapsed_ns", "Heap Elapsed Time (nanoseconds): ", heapElapsed.count());
+        writer().summaryInteger("scan_elapsed_ns", "Column Scan Elapsed Time (nanoseconds): ", scanElapsed.count());
+        writer().end();
+    }
+
+    // Where an order's profit ranks among all orders
+    void profitRank(const string& orderID) {
+        SalesData* record = salesStore.find(orderID);
+        if (record == nullptr) {
+            output() << "Order ID not found: " << orderID << endl;
+            return;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t below = profitRanks.countBelow(record->totalProfit);
+        size_t above = profitRanks.countAbove(record->totalProfit);
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        size_t n = profitRanks.size();
+        if (writer().format() != OutputFormat::Plain) {
+            writer().begin("Profit Rank of Order " + orderID,
+                         {{"order_id", ""}, {"total_profit", ""}, {"rank", ""}, {"orders", ""}, {"tied_with", ""},
+                          {"percentile", ""}});
+            writer().text(orderID);
+            writer().money(record->totalProfit);
+            writer().integer(above + 1);
+            writer().integer(n);
+            writer().integer(n - below - above - 1);
+            writer().money(100.0 * below / n);
+            writer().endRow();
+            writer().summaryInteger("elapsed_ns", "", elapsed.count());
+            writer().end();
+            return;
+        }
+        output() << fixed << setprecision(2);
+        output() << "\n--- Profit Rank of Order " << orderID << " ---\n";
+        output() << "Total Profit:     $" << record->totalProfit << "\n";
+        output() << "Rank:             " << above + 1 << " of " << n
+             << (n - below - above > 1 ? " (tied with " + to_string(n - below - above - 1) + " others)" : "") << "\n";
+        output() << "Percentile:       " << 100.0 * below / n << " (orders with lower profit)\n";
+        output() << "Elapsed Time (nanoseconds): " << elapsed.count() << endl;
+    }
+
+    // Profit at a percentile, alongside the usual quartiles
+    void profitPercentile(double p) {
+        auto start = std::chrono::high_resolution_clock::now();
+        double value = profitRanks.percentile(p);
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        if (writer().format() != OutputFormat::Plain) {
+            writer().begin("Profit Percentiles", {{"percentile", ""}, {"total_profit", ""}});
+            for (double q : {p, 0.0, 25.0, 50.0, 75.0, 90.0, 100.0}) {
+                writer().money(q);
+                writer().money(q == p ? value : profitRanks.percentile(q));
+                writer().endRow();
+            }
+            writer().summaryInteger("elapsed_ns", "", elapsed.count());
+            writer().end();
+            return;
+        }
+        output() << "\n--- Profit Percentiles ---\n";
+        output() << defaultfloat << "p" << p << ":  $" << fixed << setprecision(2) << value << "\n";
+        output() << "Elapsed Time (nanoseconds): " << elapsed.count() << "\n";
+        output() << "min $" << profitRanks.percentile(0) << ", p25 $" << profitRanks.percentile(25)
+             << ", median $" << profitRanks.percentile(50) << ", p75 $" << profitRanks.percentile(75)
+             << ", p90 $" << profitRanks.percentile(90) << ", max $" << profitRanks.percentile(100) << endl;
+    }
+
+    // Top k orders by profit within every group of a column, in one pass:
+    // each group keeps a min-heap of at most k entries whose root is the
+    // weakest order kept so far, so the pass costs O(n log k)
+    void topPerGroup(Dimension dim, size_t k) {
+        typedef pair<double, uint32_t> Entry; // profit, record ID
+        const vector<uint16_t>& codes = salesTable.codes(dim);
+        const vector<double>& profits = salesTable.totalProfit;
+        const Dictionary& dictionary = salesTable.dictionary(dim);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        vector<vector<Entry>> heaps(dictionary.size());
+        for (uint32_t id = 0; id < codes.size(); ++id) {
+            vector<Entry>& heap = heaps[codes[id]];
+            if (heap.size() < k) {
+                heap.emplace_back(profits[id], id);
+                push_heap(heap.begin(), heap.end(), greater<Entry>());
+            } else if (profits[id] > heap.front().first) {
+                pop_heap(heap.begin(), heap.end(), greater<Entry>());
+                heap.back() = Entry(profits[id], id);
+                push_heap(heap.begin(), heap.end(), greater<Entry>());
+            }
+        }
+        // sort_heap with greater<> leaves each group highest profit first
+        for (auto& heap : heaps) {
+            sort_heap(heap.begin(), heap.end(), greater<Entry>());
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        // print the groups alphabetically
+        vector<uint16_t> groups(dictionary.size());
+        for (uint16_t c = 0; c < groups.size(); ++c) groups[c] = c;
+        sort(groups.begin(), groups.end(),
+             [&](uint16_t a, uint16_t b) { return dictionary.decode(a) < dictionary.decode(b); });
+
+        writer().begin("Top " + to_string(k) + " Orders per " + dimensionName(dim),
+                     {{"rank", "  "}, {"order_id", ". "}, {"country", "  "}, {"item_type", " / "},
+                      {"total_profit", "  $"}},
+                     "group");
+        for (uint16_t group : groups) {
+            writer().section(dictionary.decode(group));
+            for (size_t i = 0; i < heaps[group].size(); ++i) {
+                const SalesData& record = *salesTable.rows[heaps[group][i].second];
+                writer().integer(i + 1);
+                writer().text(record.orderID);
+                writer().text(record.country);
+                writer().text(record.itemType);
+                writer().money(record.totalProfit);
+                writer().endRow();
+            }
+        }
+        writer().summaryInteger("elapsed_ns", "Elapsed Time (nanoseconds): ", elapsed.count());
+        writer().end();
+    }
+
+    // Aggregates for every combination of the given columns, with subtotals
+    void cubeAggregate(const vector<Dimension>& dims) {
+        Cube cube;
+        auto start = std::chrono::high_resolution_clock::now();
+        bool built = cube.build(salesTable, dims);
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        if (!built) {
+            output() << "Too many combinations, please use fewer or smaller columns\n";
+            return;
+        }
+        if (writer().format() != OutputFormat::Plain) {
+            cube.write(salesTable, writer());
+            writer().summaryInteger("cells", "", cube.numCells());
+            writer().summaryInteger("elapsed_ns", "", elapsed.count());
+            writer().end();
+            return;
         }
-        cout << "Order ID not found in Heap: " << orderID << endl;
+        cube.print(salesTable, output());
+        output() << "Cube cells: " << cube.numCells() << "\n";
+        output() << "Elapsed Time (nanoseconds): " << elapsed.count() << endl;
+    }
+
+    // Compile and run an aggregate query, see Query.h for the syntax
+    void runQuery(const string& text) {
+        Query query;
+        string error;
+        auto compileStart = std::chrono::high_resolution_clock::now();
+        bool compiled = query.compile(text, salesTable, salesIndexes, error);
+        auto compileEnd = std::chrono::high_resolution_clock::now();
+        if (!compiled) {
+            markFailed();
+            output() << "Query error: " << error << "\n";
+            output() << "Example: query sum(totalProfit), count(*) where region=Europe and channel=Online"
+                    " and year>2015 group by itemType\n";
+            output() << "Values containing \"and\" need quotes: where country=\"Bosnia and Herzegovina\"\n";
+            return;
+        }
+        bool plain = writer().format() == OutputFormat::Plain;
+        if (plain) query.printPlan(output());
+
+        auto runStart = std::chrono::high_resolution_clock::now();
+        size_t matched = query.execute(writer(), output());
+        auto runEnd = std::chrono::high_resolution_clock::now();
+
+        if (!plain) {
+            writer().summaryInteger("rows_matched", "", matched);
+            writer().summaryInteger("compile_elapsed_ns", "",
+                std::chrono::duration_cast<std::chrono::nanoseconds>(compileEnd - compileStart).count());
+            writer().summaryInteger("execute_elapsed_ns", "",
+                std::chrono::duration_cast<std::chrono::nanoseconds>(runEnd - runStart).count());
+            writer().end();
+            return;
+        }
+
+        output() << "Rows matched: " << matched << " of " << salesTable.size() << "\n";
+        output() << "Compile Elapsed Time (nanoseconds): "
+             << std::chrono::duration_cast<std::chrono::nanoseconds>(compileEnd - compileStart).count() << "\n";
+        output() << "Execute Elapsed Time (nanoseconds): "
+             << std::chrono::duration_cast<std::chrono::nanoseconds>(runEnd - runStart).count() << endl;
+    }
+
+    // Lookup a specific order by Order ID -- by heap
+    void looupOrderHeap(const string& orderID){
+        if (useBloomFilter && !orderFilter.mightContain(orderID)) {
+            output() << "Order ID not found in Heap (Bloom filter): " << orderID << "\n";
+            return;
+        }
+        // only the heap of the Order ID's shard is searched
+        const SalesData* record = salesStore.findInHeap(orderID);
+        if (record != nullptr) {
+            output() << "Search by ID Heap" << "\n";
+            printRecord(*record, orderID);
+            return;
+        }
+        output() << "Order ID not found in Heap: " << orderID << "\n";
     }
 
     // Aggregate and display profits by region -- only map
     void aggregateByRegion() {
-        salesMap.aggregateByRegion();
+        salesStore.aggregateByRegion(writer());
     }
 
     // Aggregate and display profits by country -- only map
     void aggregateByCountry() {
-        salesMap.aggregateByCountry();
+        salesStore.aggregateByCountry(writer());
     }
 
     // Find and display top-performing items -- only map
     void topPerformingItems(int n) {
-        salesMap.topPerformingItems(n);
+        salesStore.topPerformingItems(n, writer());
+    }
+
+    // Report Bloom filter memory use and its false positive rate, measured
+    // with random 9-digit Order IDs that are not loaded
+    void bloomStats() {
+        mt19937_64 rng(7);
+        uniform_int_distribution<uint64_t> nineDigits(100000000, 999999999);
+        vector<string> absentIds;
+        while (absentIds.size() < 100000) {
+            string id = to_string(nineDigits(rng));
+            if (salesStore.find(id) == nullptr) absentIds.push_back(id);
+        }
+
+        size_t falsePositives = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto& id : absentIds) {
+            if (orderFilter.mightContain(id)) falsePositives++;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double filterNs = std::chrono::duration<double, nano>(end - start).count() / absentIds.size();
+
+        size_t mapHits = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto& id : absentIds) {
+            if (salesStore.find(id) != nullptr) mapHits++;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        double mapNs = std::chrono::duration<double, nano>(end - start).count() / absentIds.size();
+
+        output() << "\n--- Bloom Filter ---\n";
+        output() << "Enabled:                  " << (useBloomFilter ? "yes" : "no") << "\n";
+        output() << "Keys:                     " << orderFilter.size()
+             << " (sized for " << orderFilter.capacity() << ")\n";
+        output() << fixed << setprecision(2);
+        output() << "Memory:                   " << orderFilter.memoryBytes() / 1024.0 << " KiB ("
+             << orderFilter.memoryBytes() * 8.0 / max<size_t>(orderFilter.size(), 1) << " bits/key)\n";
+        output() << setprecision(4);
+        output() << "False positive rate:      " << 100.0 * falsePositives / absentIds.size()
+             << "% measured, " << 100.0 * orderFilter.expectedFalsePositiveRate() << "% expected\n";
+        output() << setprecision(2);
+        output() << "Absent key, filter (ns):  " << filterNs << "\n";
+        output() << "Absent key, map (ns):     " << mapNs << (mapHits ? " (unexpected hits)" : "") << "\n";
+    }
+
+    // Print sketch estimates for one segment next to the exact answers
+    void printApproxSegment(const string& name, const SegmentSketches& sketches,
+                            const vector<uint32_t>& rows) {
+        // exact answers from the columnar table
+        unordered_set<string> orders;
+        unordered_set<uint16_t> countries;
+        vector<double> profits;
+        const vector<uint16_t>& countryCodes = salesTable.codes(Dimension::Country);
+        for (uint32_t id : rows) {
+            orders.insert(salesTable.rows[id]->orderID);
+            countries.insert(countryCodes[id]);
+            profits.push_back(salesTable.totalProfit[id]);
+        }
+        sort(profits.begin(), profits.end());
+
+        if (writer().format() != OutputFormat::Plain) {
+            writer().text(name);
+            writer().integer(sketches.memoryBytes());
+            writer().integer(llround(sketches.distinctOrders.estimate()));
+            writer().integer(orders.size());
+            writer().integer(llround(sketches.distinctCountries.estimate()));
+            writer().integer(countries.size());
+            for (double q : {0.5, 0.9, 0.99}) {
+                size_t exactIndex = min(profits.size() - 1, static_cast<size_t>(ceil(q * profits.size())) - 1);
+                writer().money(sketches.profit.quantile(q));
+                writer().money(profits[exactIndex]);
+            }
+            writer().endRow();
+            return;
+        }
+
+        // relativeError() is one standard error; three of them give a bound
+        // that holds about 99.7% of the time, like the KLL rank bound below
+        double hllError = 3 * 100 * HyperLogLog::relativeError();
+        output() << fixed << setprecision(0);
+        output() << name << " (sketches " << sketches.memoryBytes() / 1024 << " KiB)\n";
+        output() << "  Distinct orders:     ~" << sketches.distinctOrders.estimate()
+             << " +/- " << setprecision(1) << hllError << "% (3 SE)   exact " << orders.size() << "\n";
+        output() << setprecision(0);
+        output() << "  Distinct countries:  ~" << sketches.distinctCountries.estimate()
+             << " +/- " << setprecision(1) << hllError << "% (3 SE)   exact " << countries.size() << "\n";
+        for (double q : {0.5, 0.9, 0.99}) {
+            double approx = sketches.profit.quantile(q);
+            size_t exactIndex = min(profits.size() - 1, static_cast<size_t>(ceil(q * profits.size())) - 1);
+            // where the estimate actually falls among the exact profits
+            double actualRank = static_cast<double>(lower_bound(profits.begin(), profits.end(), approx)
+                                                    - profits.begin()) / profits.size();
+            string label = "  Profit p" + to_string(static_cast<int>(q * 100)) + ":";
+            output() << setprecision(2);
+            output() << left << setw(23) << label << right << "~$" << approx << " +/- " << 100 * KllSketch::rankError()
+                 << "% rank   exact $" << profits[exactIndex] << " (estimate at rank "
+                 << 100 * actualRank << "%)\n";
+        }
+    }
+
+    // Approximate distinct counts and profit quantiles per region from the
+    // sketches maintained during load, with error bounds and exact answers.
+    // The data has no customer column, so distinct Order IDs stand in for
+    // distinct customers.
+    void approxAnalytics() {
+        const GroupAggregates& aggregates = salesStore.getAggregates();
+
+        // time answering from the sketches alone
+        auto start = std::chrono::high_resolution_clock::now();
+        double checksum = 0;
+        for (const auto& region : aggregates.sketchesByRegion) {
+            checksum += region.second.distinctOrders.estimate() + region.second.distinctCountries.estimate()
+                        + region.second.profit.quantile(0.5) + region.second.profit.quantile(0.9)
+                        + region.second.profit.quantile(0.99);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto approxElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        // rows per region for the exact answers
+        start = std::chrono::high_resolution_clock::now();
+        const Dictionary& regions = salesTable.dictionary(Dimension::Region);
+        const vector<uint16_t>& regionCodes = salesTable.codes(Dimension::Region);
+        vector<vector<uint32_t>> rowsByRegion(regions.size());
+        vector<uint32_t> allRows(salesTable.size());
+        for (uint32_t id = 0; id < salesTable.size(); ++id) {
+            rowsByRegion[regionCodes[id]].push_back(id);
+            allRows[id] = id;
+        }
+
+        bool plain = writer().format() == OutputFormat::Plain;
+        if (plain) {
+            output() << "\n--- Approximate Analytics (sketch vs exact) ---\n";
+        } else {
+            writer().begin("Approximate Analytics (sketch vs exact)",
+                         {{"segment", ""}, {"sketch_bytes", ""}, {"distinct_orders", ""},
+                          {"distinct_orders_exact", ""}, {"distinct_countries", ""}, {"distinct_countries_exact", ""},
+                          {"profit_p50", ""}, {"profit_p50_exact", ""}, {"profit_p90", ""}, {"profit_p90_exact", ""},
+                          {"profit_p99", ""}, {"profit_p99_exact", ""}});
+        }
+        for (const auto& region : aggregates.byRegion.get()) {
+            int code = regions.find(region.first);
+            auto sketches = aggregates.sketchesByRegion.find(region.first);
+            if (code < 0 || sketches == aggregates.sketchesByRegion.end()) continue;
+            printApproxSegment(region.first, sketches->second, rowsByRegion[code]);
+        }
+        printApproxSegment("All regions", aggregates.overallSketches, allRows);
+        end = std::chrono::high_resolution_clock::now();
+        auto exactElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+        if (!plain) {
+            writer().summaryInteger("sketch_elapsed_ns", "", approxElapsed.count());
+            writer().summaryInteger("exact_elapsed_ns", "", exactElapsed.count());
+            writer().end();
+            return;
+        }
+        output() << "Sketch Elapsed Time (nanoseconds): " << approxElapsed.count()
+             << (checksum == 0 ? " (empty)" : "") << "\n";
+        output() << "Exact Elapsed Time (nanoseconds):  " << exactElapsed.count() << endl;
+    }
+
+    // Check the totals maintained during insert against a full recompute
+    void verifyAggregates() {
+        const GroupAggregates& aggregates = salesStore.getAggregates();
+        const pair<const char*, pair<const GroupTotals*, string SalesData::*>> checks[] = {
+                {"Region", {&aggregates.byRegion, &SalesData::region}},
+                {"Country", {&aggregates.byCountry, &SalesData::country}},
+                {"Item Type", {&aggregates.byItemType, &SalesData::itemType}},
+        };
+
+        output() << "\n--- Aggregate Consistency Check ---\n";
+        bool allMatch = true;
+        for (const auto& check : checks) {
+            const GroupTotals& maintained = *check.second.first;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            vector<pair<string, double>> recomputed = salesStore.scanTotals(check.second.second, ThreadPool::shared());
+            auto end = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+            // sums are added in a different order, so allow rounding differences
+            size_t mismatches = 0;
+            for (const auto& group : recomputed) {
+                double total = 0;
+                if (!maintained.find(group.first, total) ||
+                    fabs(total - group.second) > 1e-9 * max(1.0, fabs(group.second))) {
+                    mismatches++;
+                    output() << "  mismatch in " << group.first << ": maintained $" << fixed << setprecision(2)
+                         << total << ", recomputed $" << group.second << "\n";
+                }
+            }
+            if (maintained.get().size() != recomputed.size()) {
+                mismatches++;
+                output() << "  " << maintained.get().size() << " groups maintained, "
+                     << recomputed.size() << " recomputed\n";
+            }
+            allMatch = allMatch && mismatches == 0;
+            output() << left << setw(10) << check.first << right << setw(4) << recomputed.size() << " groups  "
+                 << (mismatches == 0 ? "OK" : "MISMATCH") << "  (recompute "
+                 << elapsed.count() << " ns)\n";
+        }
+        output() << (allMatch ? "Maintained aggregates match a full recompute.\n"
+                          : "Maintained aggregates are out of date!\n");
+    }
+
+    // Print estimated group totals, highest profit first when sortByProfit
+    void printEstimates(vector<GroupEstimate> estimates, const string& title, size_t rows,
+                        bool sortByProfit, int limit) {
+        if (sortByProfit) {
+            sort(estimates.begin(), estimates.end(),
+                 [](const GroupEstimate& a, const GroupEstimate& b) { return a.total > b.total; });
+        }
+        if (writer().format() != OutputFormat::Plain) {
+            for (int i = 0; i < min(limit, static_cast<int>(estimates.size())); ++i) {
+                writer().integer(rows);
+                writer().text(estimates[i].group);
+                writer().money(estimates[i].total);
+                writer().money(estimates[i].halfWidth);
+                writer().endRow();
+            }
+            return;
+        }
+        size_t population = salesTable.size();
+        output() << "\n--- " << title << " (approx from " << rows << " of " << population << " records, 95% CI) ---\n";
+        output() << fixed << setprecision(2);
+        for (int i = 0; i < min(limit, static_cast<int>(estimates.size())); ++i) {
+            const GroupEstimate& e = estimates[i];
+            output() << (sortByProfit ? to_string(i + 1) + ". " : "") << e.group << ": ~$" << e.total
+                 << " +/- $" << e.halfWidth << " (" << (e.total != 0 ? 100 * e.halfWidth / fabs(e.total) : 0)
+                 << "%)\n";
+        }
+    }
+
+    // Profit totals per group estimated from the reservoir sample. With
+    // refine, estimate again from random subsets 4x larger each round until
+    // the last round reads every record and is exact.
+    void approxGroupTotals(const string& title, string SalesData::* field, bool sortByProfit,
+                           int limit, bool refine) {
+        vector<const SalesData*> sample;
+        for (const auto& record : salesSample.get()) sample.push_back(&record);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        vector<GroupEstimate> estimates = estimateGroupTotals(sample, salesSample.population(), field);
+        auto end = std::chrono::high_resolution_clock::now();
+        // CSV and JSON put every round in one result, told apart by sample_rows
+        bool plain = writer().format() == OutputFormat::Plain;
+        long long totalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        if (!plain) {
+            writer().begin(title + " (approx, 95% CI)",
+                         {{"sample_rows", ""}, {"group", ""}, {"total_profit", ""}, {"half_width", ""}});
+        }
+        printEstimates(estimates, title, sample.size(), sortByProfit, limit);
+        if (plain) {
+            output() << "Elapsed Time (nanoseconds): "
+                 << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() << endl;
+        }
+        if (!refine) {
+            if (!plain) {
+                writer().summaryInteger("elapsed_ns", "", totalNs);
+                writer().end();
+            }
+            return;
+        }
+
+        // prefixes of one random order of all rows are uniform samples too
+        vector<const SalesData*> shuffled(salesTable.rows.begin(), salesTable.rows.end());
+        shuffle(shuffled.begin(), shuffled.end(), mt19937(99));
+        size_t rows = sample.size();
+        while (rows < shuffled.size()) {
+            rows = min(rows * 4, shuffled.size());
+            vector<const SalesData*> subset(shuffled.begin(), shuffled.begin() + rows);
+            start = std::chrono::high_resolution_clock::now();
+            estimates = estimateGroupTotals(subset, shuffled.size(), field);
+            end = std::chrono::high_resolution_clock::now();
+            printEstimates(estimates, title, rows, sortByProfit, limit);
+            totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            if (plain) {
+                output() << "Elapsed Time (nanoseconds): "
+                     << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() << endl;
+            }
+        }
+        if (!plain) {
+            writer().summaryInteger("elapsed_ns", "", totalNs);
+            writer().end();
+        }
+    }
+
+    // Display bucket distribution and probe statistics -- only map
+    void hashStats() {
+        salesStore.printHashStats();
+    }
+
+    // Compare hash policies on the loaded Order IDs and on synthetic ones
+    void hashBenchmark() {
+        vector<string> ids;
+        salesStore.forEachBuckets([&ids](const vector<vector<SalesData>>& buckets) {
+            for (const auto& bucket : buckets) {
+                for (const auto& record : bucket) {
+                    ids.push_back(record.orderID);
+                }
+            }
+        });
+        runHashBenchmark(ids);
     }
 
     // returns the top sale from the heap data, need a function to return the sale
     // need to use chrono here
     pair<string, SalesData> getTopSale_Heap() {
-        if (salesHeap.isEmpty()) {
+        if (salesStore.getNum_Records() == 0) {
             throw std::runtime_error("No sales data available");
         }
-        // Return the top sale (highest profit) with its Order ID
-        return salesHeap.extractMax();
+        // Return the top sale (highest profit) with its Order ID, the best
+        // of the shard roots
+        return salesStore.extractMax();
     }
 
     // top sale from hash map also need to use chrono
     pair<string,SalesData> getTopSale_Hash(){
-        if(salesMap.getNum_Records()==0) throw std::runtime_error("No sales data available");
+        if(salesStore.getNum_Records()==0) throw std::runtime_error("No sales data available");
 
-        return salesMap.displayHighestProfitRecord();
+        // every shard is scanned on its own pool task
+        const SalesData* best = salesStore.highestProfitRecord(ThreadPool::shared());
+        return make_pair(best->orderID, *best);
     }
 
-    // Interactive Command-Line Interface
-    void runCLI() {
-        // Attempt to load data if filename was provided
-        if (!filename.empty()) {
-            readCSV();
+    // Commands whose output only depends on the loaded data
+    static bool isCacheable(const string& action) {
+        return action == "regions" || action == "countries" || action == "top_items" ||
+               action == "top_per" || action == "cube" || action == "query";
+    }
+
+    // Output without its timing lines, so a cache hit does not repeat how
+    // long the original run took. In JSON the "..._elapsed_ns" key goes
+    // with the comma in front of it when it was the last one.
+    static string withoutTimings(const string& output) {
+        string kept;
+        size_t start = 0;
+        while (start < output.size()) {
+            size_t end = output.find('\n', start);
+            end = end == string::npos ? output.size() : end + 1;
+            string line = output.substr(start, end - start);
+            start = end;
+            if (line.find("Elapsed Time (") != string::npos) {
+                continue;
+            }
+            if (line[0] == '"' && line.find("elapsed_ns\": ") != string::npos) {
+                size_t close = line.find('}');
+                if (close != string::npos) {
+                    if (kept.size() >= 2 && kept.compare(kept.size() - 2, 2, ",\n") == 0) {
+                        kept.erase(kept.size() - 2, 1);
+                    }
+                    kept.append(line, close, string::npos);
+                }
+                continue;
+            }
+            kept += line;
         }
+        return kept;
+    }
 
-        string command;
+    // Collapse whitespace and spell out default arguments, so "top_items"
+    // and "top_items   5" share a cache entry
+    static string normalizeCommand(const string& command) {
+        // split on whitespace outside quotes; a quoted query value keeps
+        // its spaces, so "A  B" and "A B" get different keys
+        vector<string> words;
+        string word;
+        char quote = 0;
+        for (char c : command) {
+            if (quote == 0 && (c == '"' || c == '\'')) quote = c;
+            else if (c == quote) quote = 0;
+            if (quote == 0 && isspace(static_cast<unsigned char>(c))) {
+                if (!word.empty()) words.push_back(word);
+                word.clear();
+            } else {
+                word += c;
+            }
+        }
+        if (!word.empty()) words.push_back(word);
+        if (words.size() == 1 && words[0] == "top_items") words.push_back("5");
+        if (words.size() == 2 && words[0] == "top_per") words.push_back("3");
 
-        while (true) {
-            cout << "\n--- Sales Data Analysis CLI ---\n";
-            cout << "Commands:\n";
-            cout << "  load                - Load a new CSV file\n";
-            cout << "  lookup <order_id>   - Look up details of a specific order\n";
-            cout << "  regions             - Show total profits by region\n";
-            cout << "  countries           - Show total profits by country\n";
-            cout << "  top_items [n]       - Show top performing items (default 5)\n";
-            cout << "  top_sale            - Show the top sale (highest profit)\n";
-            cout << "  exit                - Exit the program\n";
-            cout << "\nEnter command: ";
-
-            getline(cin, command);
-            command = trim(command);
+        string key;
+        for (const auto& w : words) {
+            key += (key.empty() ? "" : " ") + w;
+        }
+        return key;
+    }
+
+    // Commands that can answer from the records published so far while a
+    // load is still running; the others need the indexes and wait for it
+    static bool runsOnPartialData(const string& command) {
+        istringstream iss(command);
+        string action;
+        iss >> action;
+        if (command.find("--approx") != string::npos || command.find("--refine") != string::npos) {
+            return false;
+        }
+        return action == "lookup" || action == "lookup_batch" || action == "regions" ||
+               action == "countries" || action == "top_items" || action == "top_sale" ||
+               action == "bloom" || action == "hashstats" || action == "cache_stats" || action == "format";
+    }
 
-            // Parse command
-            istringstream iss(command);
-            string action;
-            iss >> action;
+    // Run one command line; false once the user asks to exit.
+    // While a background load runs, commands either read the records
+    // published so far or wait for the load to finish.
+    bool executeCommand(const string& command) {
+        istringstream iss(command);
+        string action;
+        iss >> action;
+        // these manage the loader themselves and must not hold the data lock
+        if (action == "load" || action == "load_dir" || action == "wait" || action == "progress" ||
+            action == "shards" || action == "exit") {
+            bool keepGoing = dispatchCommand(command);
+            printLoadMessages();
+            return keepGoing;
+        }
+
+        bool partial = loading && runsOnPartialData(command);
+        if (loading && !partial) {
+            waitForLoad();
+        }
+        bool keepGoing;
+        {
+            shared_lock<shared_mutex> lock(dataMutex);
+            keepGoing = runCommand(command);
+            if (partial && loading) {
+                output() << fixed << setprecision(1);
+                output() << "(partial result: " << rowsIngested << " rows loaded so far, "
+                     << (bytesTotal ? 100.0 * bytesIngested / bytesTotal : 0.0) << "% of the file)\n";
+            }
+        }
+        printLoadMessages();
+        return keepGoing;
+    }
+
+    // Run one command with the data lock held.
+    // Aggregations are answered from the result cache when possible.
+    bool runCommand(const string& command) {
+        istringstream iss(command);
+        string action;
+        iss >> action;
+        if (!isCacheable(action) || salesStore.getNum_Records() == 0) {
+            return dispatchCommand(command);
+        }
 
-            if (action == "load") {
-                // Clear existing data and load new file
-                filename = "";
+        string key = normalizeCommand(command);
+        if (writer().format() != OutputFormat::Plain) {
+            key += string(" --format=") + outputFormatName(writer().format());
+        }
+        // server requests share the cache, so it has a lock of its own;
+        // a hit is copied out before the lock is released
+        auto start = std::chrono::high_resolution_clock::now();
+        string cached;
+        bool hit;
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            const string* entry = queryCache.find(key, datasetVersion);
+            hit = entry != nullptr;
+            if (hit) cached = *entry;
+        }
+        if (hit) {
+            output() << cached;
+            auto end = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+            {
+                lock_guard<mutex> lock(cacheMutex);
+                queryCache.recordSaving(key, elapsed.count());
+            }
+            if (writer().format() == OutputFormat::Plain) {
+                output() << "(cached result, served in " << elapsed.count() << " ns)\n";
+            }
+            return true;
+        }
+
+        // run it while capturing what it prints
+        RequestOutput captured(writer().format());
+        {
+            RequestScope scope(captured);
+            dispatchCommand(command);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+        string text = captured.text.str();
+        if (!captured.failed) {
+            lock_guard<mutex> lock(cacheMutex);
+            queryCache.store(key, withoutTimings(text), elapsed.count());
+        }
+        output() << text;
+        return true;
+    }
+
+    // Run one command line without the cache; false on exit
+    bool dispatchCommand(const string& command) {
+        // Parse command
+        istringstream iss(command);
+        string action;
+        iss >> action;
+
+        if (action == "load") {
+            // Load a new file on top of the current data, from the argument
+            // if one is given (quotes optional), otherwise prompt for it.
+            // Several files or a pattern like data/*.csv load as one.
+            string argument;
+            getline(iss, argument);
+            argument = trim(argument);
+            if (argument.empty() && compactOutput) {
+                output() << "Please provide a file: load <path>\n";
+                return true;
+            }
+            vector<string> files{argument};
+            if (!argument.empty()) {
+                files = expandLoadArgument(argument);
+                if (files.empty()) {
+                    return true;
+                }
+            }
+            if (loading) {
+                output() << "Another load is still running.\n";
+            }
+            waitForLoad();
+            if (files.size() > 1) {
+                loadFiles(files, argument);
+                return true;
+            }
+            filename = files[0];
+            if (backgroundLoads) {
+                startBackgroundLoad();
+            } else {
                 readCSV();
             }
-            else if (action == "lookup") {
-                if (salesMap.getNum_Records() == 0) {
-                    cout << "No data loaded. Please load a CSV file first.\n";
-                    continue;
+        }
+#ifdef __linux__
+        else if (action == "load_dir" || action == "readbench") {
+            string dir;
+            getline(iss, dir);
+            dir = trim(dir);
+            if (dir.size() >= 2 && (dir.front() == '"' || dir.front() == '\'') && dir.back() == dir.front()) {
+                dir = dir.substr(1, dir.length() - 2);
+            }
+            if (dir.empty()) {
+                output() << "Usage: " << action << " <directory>\n";
+                return true;
+            }
+            if (action == "readbench") {
+                vector<string> files;
+                string error;
+                if (listCsvFiles(dir, files, error)) {
+                    runReadBenchmark(files);
+                } else {
+                    output() << error << "\n";
                 }
+                return true;
+            }
+            if (loading) {
+                output() << "Another load is still running.\n";
+            }
+            waitForLoad();
+            loadDirectory(dir);
+        }
+#endif
+        else if (action == "shards") {
+            // Show the shards, or split the records over n of them; this
+            // moves every record, so it takes the data lock itself
+            string count;
+            iss >> count;
+            waitForLoad();
+            if (count.empty()) {
+                shared_lock<shared_mutex> lock(dataMutex);
+                salesStore.printShards();
+                return true;
+            }
+            size_t n;
+            if (!parseCount(count, ShardedStore::MAX_SHARDS, n) || n < 1) {
+                output() << "Usage: shards [n] (n from 1 to " << ShardedStore::MAX_SHARDS << ")\n";
+                return true;
+            }
+            unique_lock<shared_mutex> lock(dataMutex);
+            auto start = std::chrono::high_resolution_clock::now();
+            salesStore.reshard(n, ThreadPool::shared());
+            auto end = std::chrono::high_resolution_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+            output() << "Split " << salesStore.getNum_Records() << " records over " << n << (n == 1 ? " shard in " : " shards in ")
+                 << elapsed.count() << " ms.\n";
+            // the table and indexes point into the old maps
+            datasetVersion++;
+            if (salesStore.getNum_Records() > 0) {
+                buildIndexes(output());
+            }
+        }
+        else if (action == "wait") {
+            if (loaderThread.joinable()) {
+                waitForLoad();
+            } else {
+                output() << "No load is running.\n";
+            }
+        }
+        else if (action == "progress") {
+            printProgress();
+        }
+        else if (action == "loadstats") {
+            if (lastLoadStats.wallNs == 0) {
+                output() << "No load has finished yet.\n";
+                return true;
+            }
+            LoadPipeline::report(lastLoadStats);
+        }
+        else if (action == "lookup") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
 
-                string orderID;
-                if (iss >> orderID) {
-                    // Timing for Heap lookup
-                    auto heapStart = std::chrono::high_resolution_clock::now();
-                    looupOrderHeap(orderID);
-                    auto heapEnd = std::chrono::high_resolution_clock::now();
-                    auto heapElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(heapEnd - heapStart);
-                    cout << "Heap Elapsed Time (nanoseconds): " << heapElapsed.count() << endl;
-
-                    // Timing for HashMap lookup
-                    auto mapStart = std::chrono::high_resolution_clock::now();
-                    lookupOrderMap(orderID);
-                    auto mapEnd = std::chrono::high_resolution_clock::now();
-                    auto mapElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(mapEnd - mapStart);
-                    cout << "Hash Map Elapsed Time (nanoseconds): " << mapElapsed.count() << endl;
-                } else {
-                    cout << "Please provide an Order ID\n";
+            string orderID;
+            if (iss >> orderID && writer().format() != OutputFormat::Plain) {
+                writeLookup(orderID);
+            } else if (!orderID.empty()) {
+                // Timing for Heap lookup
+                auto heapStart = std::chrono::high_resolution_clock::now();
+                looupOrderHeap(orderID);
+                auto heapEnd = std::chrono::high_resolution_clock::now();
+                auto heapElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(heapEnd - heapStart);
+                output() << "Heap Elapsed Time (nanoseconds): " << heapElapsed.count() << "\n";
+
+                // Timing for HashMap lookup
+                auto mapStart = std::chrono::high_resolution_clock::now();
+                lookupOrderMap(orderID);
+                auto mapEnd = std::chrono::high_resolution_clock::now();
+                auto mapElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(mapEnd - mapStart);
+                output() << "Hash Map Elapsed Time (nanoseconds): " << mapElapsed.count() << "\n";
+
+                // the sorted index is rebuilt once the load finishes
+                if (loading) {
+                    output() << "Sorted Index: not available until the load finishes\n";
+                    return true;
                 }
+
+                // Timing for sorted index lookup
+                auto indexStart = std::chrono::high_resolution_clock::now();
+                lookupOrderIndex(orderID);
+                auto indexEnd = std::chrono::high_resolution_clock::now();
+                auto indexElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(indexEnd - indexStart);
+                output() << "Sorted Index Elapsed Time (nanoseconds): " << indexElapsed.count() << "\n";
+            } else {
+                output() << "Please provide an Order ID\n";
+            }
+        }
+        else if (action == "lookup_batch") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
             }
-            else if (action == "regions") {
-                if (salesMap.getNum_Records() == 0) {
-                    cout << "No data loaded. Please load a CSV file first.\n";
-                    continue;
+
+            string path;
+            if (iss >> path) {
+                lookupBatch(path);
+            } else {
+                output() << "Please provide a file of Order IDs\n";
+            }
+        }
+        else if (action == "orders") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            ordersMatching(iss);
+        }
+        else if (action == "range") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            string low, high;
+            uint64_t lowKey, highKey;
+            size_t limit = 20;
+            if (iss >> low >> high && parseOrderID(low, lowKey) && parseOrderID(high, highKey)) {
+                string count;
+                if (iss >> count && !parseCount(count, SIZE_MAX, limit)) {
+                    output() << "Usage: range <lo> <hi> [n] (n a whole number)\n";
+                    return true;
                 }
-                aggregateByRegion();
+                ordersInRange(lowKey, highKey, limit);
+            } else {
+                output() << "Please provide two numeric Order IDs\n";
             }
-            else if (action == "countries") {
-                if (salesMap.getNum_Records() == 0) {
-                    cout << "No data loaded. Please load a CSV file first.\n";
-                    continue;
+        }
+        else if (action == "nearest") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            string orderID;
+            uint64_t key;
+            if (iss >> orderID && parseOrderID(orderID, key)) {
+                nearestOrders(key);
+            } else {
+                output() << "Please provide a numeric Order ID\n";
+            }
+        }
+        else if (action == "orders_above") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            double threshold;
+            size_t limit = 20;
+            if (iss >> threshold) {
+                string count;
+                if (iss >> count && !parseCount(count, SIZE_MAX, limit)) {
+                    output() << "Usage: orders_above <p> [n] (n a whole number)\n";
+                    return true;
                 }
-                aggregateByCountry();
+                ordersAbove(threshold, limit);
+            } else {
+                output() << "Please provide a profit threshold\n";
+            }
+        }
+        else if (action == "rank") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            string orderID;
+            if (iss >> orderID) {
+                profitRank(orderID);
+            } else {
+                output() << "Please provide an Order ID\n";
+            }
+        }
+        else if (action == "percentile") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
             }
-            else if (action == "top_items") {
-                if (salesMap.getNum_Records() == 0) {
-                    cout << "No data loaded. Please load a CSV file first.\n";
-                    continue;
+            double p;
+            if (iss >> p && p >= 0 && p <= 100) {
+                profitPercentile(p);
+            } else {
+                output() << "Please provide a percentile between 0 and 100\n";
+            }
+        }
+        else if (action == "regions" || action == "countries" || action == "top_items") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            // optional count for top_items and the --approx / --refine flags
+            int n = 5;
+            bool approx = false, refine = false;
+            string arg;
+            while (iss >> arg) {
+                if (arg == "--approx") approx = true;
+                else if (arg == "--refine") approx = refine = true;
+                else if (action == "top_items") {
+                    size_t count;
+                    if (!parseCount(arg, INT_MAX, count)) {
+                        markFailed();
+                        output() << "Usage: top_items [n] [--approx | --refine] (n a whole number)\n";
+                        return true;
+                    }
+                    n = static_cast<int>(count);
+                }
+                else {
+                    markFailed();
+                    output() << "Unknown option: " << arg << "\n";
+                    return true;
                 }
-                int n = 5;
-                if (iss >> n) {
-                    topPerformingItems(n);
+            }
+            if (approx && action == "regions") {
+                approxGroupTotals("Total Profits by Region", &SalesData::region, false, INT_MAX, refine);
+            } else if (approx && action == "countries") {
+                approxGroupTotals("Total Profits by Country", &SalesData::country, true, INT_MAX, refine);
+            } else if (approx) {
+                approxGroupTotals("Top " + to_string(n) + " Performing Items", &SalesData::itemType, true, n, refine);
+            } else if (action == "regions") {
+                aggregateByRegion();
+            } else if (action == "countries") {
+                aggregateByCountry();
+            } else {
+                topPerformingItems(n);
+            }
+        }
+        else if (action == "top_per") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            string column;
+            Dimension dim;
+            int k = 3;
+            if (iss >> column && parseDimension(column, dim)) {
+                iss >> k;
+                if (k > 0) {
+                    topPerGroup(dim, k);
                 } else {
-                    topPerformingItems(5);
+                    markFailed();
+                    output() << "k must be positive\n";
                 }
+            } else {
+                markFailed();
+                output() << "Please provide a column: region, country, item, channel or priority\n";
             }
-            else if (action == "top_sale") {
-                if (salesMap.getNum_Records() == 0 && salesHeap.isEmpty()) {
-                    cout << "No data loaded. Please load a CSV file first.\n";
-                    continue;
+        }
+        else if (action == "cube") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            vector<Dimension> dims;
+            string column;
+            bool valid = true;
+            while (iss >> column) {
+                Dimension dim;
+                if (!parseDimension(column, dim) || std::find(dims.begin(), dims.end(), dim) != dims.end()) {
+                    markFailed();
+                    output() << "Unknown or repeated column: " << column << "\n";
+                    valid = false;
+                    break;
                 }
-                try {
-                    // start time for the heap to get the top sale
-                    auto start = std::chrono::high_resolution_clock::now();
+                dims.push_back(dim);
+            }
+            if (!valid) return true;
+            if (dims.empty()) {
+                markFailed();
+                output() << "Please provide columns: region, country, item, channel or priority\n";
+                return true;
+            }
+            cubeAggregate(dims);
+        }
+        else if (action == "query") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            string text;
+            getline(iss, text);
+            runQuery(text);
+        }
+        else if (action == "top_sale") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            try {
+                // start time for the heap to get the top sale
+                auto start = std::chrono::high_resolution_clock::now();
+
+                // Get top sale with Order ID from heap
+                auto topSaleHeap = getTopSale_Heap();
 
-                    // Get top sale with Order ID from heap
-                    auto topSaleHeap = getTopSale_Heap();
+                // get end time and time elapsed for heap to get top sale
+                auto end = std::chrono::high_resolution_clock::now();
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
 
-                    // get end time and time elapsed for heap to get top sale
-                    auto end = std::chrono::high_resolution_clock::now();
-                    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+                // start time for the hash map to get the top sale
+                auto start2 = std::chrono::high_resolution_clock::now();
 
-                    // start time for the hash map to get the top sale
-                    auto start2 = std::chrono::high_resolution_clock::now();
+                // get top sale from hash map
+                auto topSaleMap = getTopSale_Hash();
 
-                    // get top sale from hash map
-                    auto topSaleMap = getTopSale_Hash();
+                // get end time and time elapsed for hash map to get top sale
+                auto end2 = std::chrono::high_resolution_clock::now();
+                auto elapsed2 = std::chrono::duration_cast<std::chrono::nanoseconds>(end2 - start2);
 
-                    // get end time and time elapsed for hash map to get top sale
-                    auto end2 = std::chrono::high_resolution_clock::now();
-                    auto elapsed2 = std::chrono::duration_cast<std::chrono::nanoseconds>(end2 - start2);
+                if (writer().format() != OutputFormat::Plain) {
+                    writer().begin("Top Sale (Highest Profit)", recordColumns({{"source", ""}, {"elapsed_ns", ""}}));
+                    writer().text("heap");
+                    writer().integer(elapsed.count());
+                    writeRecordCells(topSaleHeap.second);
+                    writer().endRow();
+                    writer().text("hash_map");
+                    writer().integer(elapsed2.count());
+                    writeRecordCells(topSaleMap.second);
+                    writer().endRow();
+                    writer().end();
+                    return true;
+                }
 
-                    // print details for both heap and hash map
-                    cout << "\n--- Top Sale Heap (Highest Profit) ---\n";
-                    // Pass Order ID to printDetails method from heap
-                    topSaleHeap.second.printDetails(topSaleHeap.first);
+                // print details for both heap and hash map
+                output() << "\n--- Top Sale Heap (Highest Profit) ---\n";
+                // Pass Order ID to printDetails method from heap
+                printRecord(topSaleHeap.second, topSaleHeap.first);
 
-                    // print heap elapsed time
-                    cout << "Heap Elapsed Time (Nanoseconds): " << elapsed.count() << endl;
+                // print heap elapsed time
+                output() << "Heap Elapsed Time (Nanoseconds): " << elapsed.count() << endl;
 
-                    cout << "\n--- Top Sale Hash Map (Highest Profit) ---\n";
-                    // Pass Order ID to printDetails method from map
-                    topSaleMap.second.printDetails(topSaleMap.first);
+                output() << "\n--- Top Sale Hash Map (Highest Profit) ---\n";
+                // Pass Order ID to printDetails method from map
+                printRecord(topSaleMap.second, topSaleMap.first);
 
-                    // print hash map elapsed time
-                    cout << "Hash Map Elapsed Time (Nanoseconds): " << elapsed2.count() << endl;
+                // print hash map elapsed time
+                output() << "Hash Map Elapsed Time (Nanoseconds): " << elapsed2.count() << endl;
 
-                } catch (const exception& e) {
-                    cout << "Error: " << e.what() << endl;
+            } catch (const exception& e) {
+                output() << "Error: " << e.what() << endl;
+            }
+        }
+        else if (action == "bloom") {
+            string toggle;
+            if (iss >> toggle) {
+                if (serving) {
+                    output() << "bloom on|off is not available in server mode\n";
+                } else if (toggle == "on" || toggle == "off") {
+                    useBloomFilter = toggle == "on";
+                    output() << "Bloom filter " << (useBloomFilter ? "enabled" : "disabled") << " for lookups\n";
+                } else {
+                    output() << "Usage: bloom [on|off]\n";
                 }
+                return true;
+            }
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            bloomStats();
+        }
+        else if (action == "approx") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            approxAnalytics();
+        }
+        else if (action == "verify_aggregates") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            verifyAggregates();
+        }
+        else if (action == "cache_stats") {
+            queryCache.printStats();
+        }
+        else if (action == "hashstats") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            hashStats();
+        }
+        else if (action == "hashbench") {
+            hashBenchmark();
+        }
+        else if (action == "poolbench") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            int maxWorkers = 8;
+            iss >> maxWorkers;
+            if (maxWorkers < 1) {
+                output() << "Worker count must be positive\n";
+                return true;
+            }
+            vector<SalesData> records;
+            records.reserve(salesTable.size());
+            for (const SalesData* record : salesTable.rows) records.push_back(*record);
+            vector<const CustomHashMap<>*> maps;
+            for (size_t s = 0; s < salesStore.numShards(); ++s) maps.push_back(&salesStore.shard(s).map);
+            runPoolBenchmark(maps, records, maxWorkers);
+        }
+        else if (action == "concbench") {
+            if (salesStore.getNum_Records() == 0) {
+                output() << "No data loaded. Please load a CSV file first.\n";
+                return true;
+            }
+            int maxThreads = 64;
+            iss >> maxThreads;
+            if (maxThreads < 1) {
+                output() << "Thread count must be positive\n";
+                return true;
+            }
+            vector<const SalesData*> records(salesTable.rows.begin(), salesTable.rows.end());
+            runConcurrentMapBenchmark(records, maxThreads);
+        }
+        else if (action == "format") {
+            string name;
+            OutputFormat format;
+            if (!(iss >> name)) {
+                output() << "Output format: " << outputFormatName(writer().format()) << "\n";
+            } else if (serving) {
+                output() << "The server's output format is set with --format\n";
+            } else if (parseOutputFormat(name, format)) {
+                writer().setFormat(format);
+                output() << "Output format: " << name << "\n";
+            } else {
+                output() << "Usage: format [plain|csv|json]\n";
+            }
+        }
+        else if (action == "exit") {
+            if (loading) {
+                cancelLoad = true;
             }
-            else if (action == "exit") {
-                cout << "Exiting...\n";
+            waitForLoad();
+            output() << "Exiting...\n";
+            return false;
+        }
+        else {
+            output() << "Unknown command. Please try again.\n";
+        }
+        return true;
+    }
+
+    void setOutputFormat(OutputFormat format) {
+        defaultWriter.setFormat(format);
+    }
+
+    // Split the records over n shards from the start
+    void setShards(size_t n) {
+        salesStore.reshard(n, ThreadPool::shared());
+    }
+
+    // Run a command and return what it printed without blank lines,
+    // ended by a line holding a single "."
+    string runFramed(const string& command, bool& keepGoing) {
+        ostringstream captured;
+        {
+            CoutRedirect redirect(captured.rdbuf());
+            keepGoing = executeCommand(command);
+        }
+        return frame(captured.str());
+    }
+
+    // Output without blank lines, ended by a line holding a single "."
+    static string frame(const string& output) {
+        string result;
+        istringstream lines(output);
+        string line;
+        while (getline(lines, line)) {
+            if (!line.empty()) result += line + "\n";
+        }
+        result += ".\n";
+        return result;
+    }
+
+#ifdef __linux__
+    // Commands that only read the loaded data and write nothing but their
+    // own output; the server runs these on several workers at once
+    static bool runsConcurrently(const string& command) {
+        istringstream iss(command);
+        string action;
+        iss >> action;
+        return action == "lookup" || action == "lookup_batch" || action == "orders" || action == "range" ||
+               action == "nearest" || action == "orders_above" || action == "rank" || action == "percentile" ||
+               action == "regions" || action == "countries" || action == "top_items" || action == "top_per" ||
+               action == "cube" || action == "query" || action == "top_sale" || action == "approx" ||
+               action == "verify_aggregates";
+    }
+
+    // Server mode: serve commands to clients on a Unix socket or
+    // "tcp:<port>", with responses framed as in batch mode. Every request
+    // writes to its own output stream and result writer. Read-only commands
+    // run side by side under the shared data lock; the rest (load, shards,
+    // benchmarks, ...) run alone. False when the address cannot be served.
+    bool serve(const string& address, size_t workers, const string& file) {
+        compactOutput = true;
+        backgroundLoads = false;
+        if (!file.empty()) {
+            executeCommand("load " + file);
+            output() << flush;
+        }
+        serving = true;
+        shared_mutex commandMutex;
+        QueryServer server([this, &commandMutex](const string& command) {
+            RequestOutput request(defaultWriter.format());
+            RequestScope scope(request);
+            if (runsConcurrently(command)) {
+                shared_lock<shared_mutex> lock(commandMutex);
+                executeCommand(command);
+            } else {
+                // these may still print to cout from helpers outside the CLI
+                unique_lock<shared_mutex> lock(commandMutex);
+                CoutRedirect redirect(request.text.rdbuf());
+                executeCommand(command);
+            }
+            return frame(request.text.str());
+        }, workers);
+        return server.run(address);
+    }
+#endif
+
+    // Script mode: run one command per line from in without the menu or
+    // prompts. Records print on one line, blank lines are dropped, and every
+    // command's result ends with a line holding a single "." so a caller
+    // can split the stream. Output is written per command, not per line.
+    void runBatch(istream& in) {
+        ios::sync_with_stdio(false);
+        compactOutput = true;
+        backgroundLoads = false;
+
+        string command;
+        while (getline(in, command)) {
+            command = trim(command);
+            if (command.empty() || command[0] == '#') continue;
+
+            bool keepGoing;
+            string result = runFramed(command, keepGoing);
+            output().write(result.data(), result.size());
+            if (!keepGoing) break;
+        }
+        output().flush();
+    }
+
+    // Interactive Command-Line Interface
+    void runCLI() {
+        // Attempt to load data if filename was provided
+        if (!filename.empty()) {
+            executeCommand("load " + filename);
+        }
+
+        string command;
+
+        while (true) {
+            printLoadMessages();
+            output() << "\n--- Sales Data Analysis CLI ---\n";
+            output() << "Commands:\n";
+            output() << "  load [path]         - Load a CSV file in the background\n";
+            output() << "  load <files|glob>   - Load several files, e.g. load data/*.csv, as one\n";
+#ifdef __linux__
+            output() << "  load_dir <dir>      - Load every CSV file in a directory (io_uring reads)\n";
+            output() << "  readbench <dir>     - Compare ifstream, pread and io_uring read speed on a directory\n";
+#endif
+            output() << "  progress            - Show how far the current load has got\n";
+            output() << "  wait                - Wait for the current load to finish\n";
+            output() << "  loadstats           - Per-stage timings of the last load pipeline\n";
+            output() << "  lookup <order_id>   - Look up details of a specific order\n";
+            output() << "  lookup_batch <file> - Look up every Order ID listed in a file\n";
+            output() << "  orders <col>=<val>  - Orders matching filters (region, country, item, channel, priority)\n";
+            output() << "  range <lo> <hi> [n] - Orders with IDs between lo and hi (prints first n)\n";
+            output() << "  nearest <order_id>  - Closest loaded Order IDs below and above an ID\n";
+            output() << "  orders_above <p> [n]- Orders with profit above p (prints first n)\n";
+            output() << "  rank <order_id>     - Rank and percentile of an order's profit\n";
+            output() << "  percentile <p>      - Profit at percentile p (0-100)\n";
+            output() << "  regions             - Show total profits by region\n";
+            output() << "  countries           - Show total profits by country\n";
+            output() << "  top_items [n]       - Show top performing items (default 5)\n";
+            output() << "                        (regions/countries/top_items take --approx, --refine)\n";
+            output() << "  cube <col> [col...] - Profit for every combination of columns with subtotals\n";
+            output() << "  query <aggs> [where ...] [group by <col>] - e.g. query sum(profit) where region=Asia\n";
+            output() << "                        (quote values containing \"and\": country=\"Bosnia and Herzegovina\")\n";
+            output() << "  top_sale            - Show the top sale (highest profit)\n";
+            output() << "  top_per <col> [k]   - Top k orders in each region/country/item/channel/priority\n";
+            output() << "  bloom [on|off]      - Show Bloom filter stats or toggle it for lookups\n";
+            output() << "  approx              - Approximate distinct counts and profit quantiles per region\n";
+            output() << "  verify_aggregates   - Check maintained totals against a full recompute\n";
+            output() << "  cache_stats         - Show query result cache hit rate and time saved\n";
+            output() << "  hashstats           - Show hash map bucket and probe statistics\n";
+            output() << "  shards [n]          - Show the shards, or split the records over n of them\n";
+            output() << "  hashbench           - Benchmark hash policies on real and synthetic IDs\n";
+            output() << "  concbench [threads] - Lookup throughput of the concurrent hash map, 1 to 64 threads\n";
+            output() << "  poolbench [workers] - Task spawn cost and parallel speedup of the thread pool\n";
+            output() << "  format [fmt]        - Print results as plain, csv or json\n";
+            output() << "                        (diagnostics such as hashstats, cache_stats, loadstats, shards,\n";
+            output() << "                         bloom and the benchmarks always print plain text)\n";
+            output() << "  exit                - Exit the program\n";
+            output() << "\nEnter command: ";
+
+            if (!getline(cin, command)) {
                 break;
             }
-            else {
-                cout << "Unknown command. Please try again.\n";
+            command = trim(command);
+
+            if (!executeCommand(command)) {
+                break;
             }
         }
     }
 };
 
-int main() {
-    // Create CLI
-    SalesDataCLI cli;
+int main(int argc, char* argv[]) {
+    // Batch mode when stdin is not a terminal, unless told otherwise
+    bool batch = !isatty(fileno(stdin));
+    string loadFile, scriptFile, serveAddress, loadgenAddress, commandsFile;
+    size_t workers = max(2u, thread::hardware_concurrency());
+    size_t clients = 8, requests = 10000;
+    // each worker and each load generator client is a thread
+    const size_t MAX_THREADS = 1024;
+    size_t shards = 1;
+    OutputFormat format = OutputFormat::Plain;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--batch") batch = true;
+        else if (arg == "--interactive") batch = false;
+        else if (arg == "--load" && i + 1 < argc) loadFile = argv[++i];
+        else if (arg == "--format" && i + 1 < argc && parseOutputFormat(argv[i + 1], format)) ++i;
+        else if (arg == "--script" && i + 1 < argc) {
+            scriptFile = argv[++i];
+            batch = true;
+        }
+        else if (arg == "--serve" && i + 1 < argc) serveAddress = argv[++i];
+        else if (arg == "--workers" && i + 1 < argc && parseCount(argv[i + 1], MAX_THREADS, workers) && workers >= 1) ++i;
+        else if (arg == "--loadgen" && i + 1 < argc) loadgenAddress = argv[++i];
+        else if (arg == "--clients" && i + 1 < argc && parseCount(argv[i + 1], MAX_THREADS, clients) && clients >= 1) ++i;
+        else if (arg == "--requests" && i + 1 < argc && parseCount(argv[i + 1], SIZE_MAX, requests) &&
+                 requests >= 1) ++i;
+        else if (arg == "--commands" && i + 1 < argc) commandsFile = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc && parseCount(argv[i + 1], ShardedStore::MAX_SHARDS, shards) &&
+                 shards >= 1) ++i;
+        else {
+            cerr << "Usage: " << argv[0] << " [--batch | --interactive] [--load <csv>] [--script <file>]"
+                 << " [--format plain|csv|json] [--shards n]\n"
+                 << "       " << argv[0] << " --serve <socket|tcp:port> [--load <csv>] [--workers n] [--shards n]"
+                 << " [--format plain|csv|json]\n"
+                 << "       " << argv[0] << " --loadgen <socket|tcp:port> [--commands <file>]"
+                 << " [--clients n] [--requests n]\n";
+            return 1;
+        }
+    }
+
+    if (!loadgenAddress.empty()) {
+#ifdef __linux__
+        // Commands from the file, one per line, or the default mix
+        vector<string> commands;
+        if (!commandsFile.empty()) {
+            ifstream file(commandsFile);
+            string line;
+            while (getline(file, line)) {
+                if (!line.empty() && line[0] != '#') commands.push_back(line);
+            }
+        }
+        if (commands.empty()) commands = {"regions", "top_items", "top_sale"};
+        LoadGenerator::run(loadgenAddress, commands, clients, requests);
+        return 0;
+#else
+        cerr << "--loadgen needs Linux\n";
+        return 1;
+#endif
+    }
 
-    // Run interactive CLI
-    cli.runCLI();
+    if (!serveAddress.empty()) {
+#ifdef __linux__
+        SalesDataCLI server;
+        server.setShards(shards);
+        server.setOutputFormat(format);
+        return server.serve(serveAddress, workers, loadFile) ? 0 : 1;
+#else
+        cerr << "--serve needs Linux\n";
+        return 1;
+#endif
+    }
+
+    // Create CLI; the interactive CLI loads --load itself, batch mode runs it as a command
+    SalesDataCLI cli(batch ? "" : loadFile);
+    cli.setOutputFormat(format);
+    cli.setShards(shards);
+
+    if (!batch) {
+        // Run interactive CLI
+        cli.runCLI();
+        return 0;
+    }
 
+    // Run a command script, from a file or stdin
+    string script;
+    if (!loadFile.empty()) script += "load " + loadFile + "\n";
+    if (!scriptFile.empty()) {
+        ifstream file(scriptFile);
+        if (!file.is_open()) {
+            cerr << "Could not open script: " << scriptFile << endl;
+            return 1;
+        }
+        script += string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        istringstream in(script);
+        cli.runBatch(in);
+    } else if (!loadFile.empty()) {
+        istringstream in(script);
+        cli.runBatch(in);
+        cli.runBatch(cin);
+    } else {
+        cli.runBatch(cin);
+    }
     return 0;
 }
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <vector>
 #include "SalesData.h"
+#include "ThreadPool.h"
 using namespace std;
 
 // sorted by total profit
@@ -46,6 +47,29 @@ public:
         heapifyUp(heap.size() - 1);
     }
 
+    // Replace the contents with items and heapify bottom up (Floyd), O(n)
+    // instead of O(n log n) inserts. With a pool, every level of parents is
+    // sifted down in parallel: their subtrees are disjoint, and a level only
+    // starts once the levels below it are done.
+    void build(vector<SalesData> items, ThreadPool* pool = nullptr) {
+        heap = move(items);
+        int lastParent = static_cast<int>(heap.size()) / 2 - 1;
+        if (lastParent < 0) return;
+        int level = 0;
+        while ((2 << level) - 1 <= lastParent) level++;
+        for (; level >= 0; --level) {
+            int first = (1 << level) - 1;
+            int last = min((2 << level) - 1, lastParent + 1);
+            if (pool != nullptr && last - first >= 1024) {
+                parallelFor(*pool, first, last, defaultGrain(last - first, *pool), [this](size_t from, size_t to) {
+                    for (size_t i = to; i-- > from;) heapifyDown(static_cast<int>(i));
+                });
+            } else {
+                for (int i = last - 1; i >= first; --i) heapifyDown(i);
+            }
+        }
+    }
+
     pair<string, SalesData> extractMax() {
         if (heap.empty()) {
             throw out_of_range("Heap is empty");
@@ -57,6 +81,24 @@ public:
         return make_pair(max.orderID,max);
     }
 
+    // Collect every record with profit above threshold. Walks the heap from
+    // the root and skips any subtree whose root is not above the threshold,
+    // since nothing below it can be either: O(k) for k results, not O(n).
+    void collectAbove(double threshold, vector<const SalesData*>& out) const {
+        vector<int> stack;
+        if (!heap.empty()) stack.push_back(0);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            if (heap[index].totalProfit <= threshold) continue;
+            out.push_back(&heap[index]);
+            int leftChildIndex = 2 * index + 1;
+            int rightChildIndex = 2 * index + 2;
+            if (rightChildIndex < static_cast<int>(heap.size())) stack.push_back(rightChildIndex);
+            if (leftChildIndex < static_cast<int>(heap.size())) stack.push_back(leftChildIndex);
+        }
+    }
+
     void display() const {
         for (int i = 0; i < heap.size(); ++i) {
             cout << heap[i].totalProfit << " ";
@@ -71,7 +113,7 @@ public:
     bool isEmpty() const {
         return heap.empty();
     }
-    vector<SalesData> getHeap(){
+    const vector<SalesData>& getHeap() const {
         return heap;
     }
 };